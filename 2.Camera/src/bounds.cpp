@@ -0,0 +1,87 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "bounds.h"
+
+#include <cmath>
+
+void Aabb::add(const glm::fvec3& point) {
+    low = glm::min(low, point);
+    high = glm::max(high, point);
+}
+
+void Aabb::add(const Aabb& box) {
+    low = glm::min(low, box.low);
+    high = glm::max(high, box.high);
+}
+
+bool Aabb::empty() const {
+    return low.x > high.x;
+}
+
+glm::fvec3 Aabb::center() const {
+    return (low + high) * 0.5f;
+}
+
+glm::fvec3 Aabb::extent() const {
+    return (high - low) * 0.5f;
+}
+
+Aabb Aabb::transformed(const glm::fmat4& transform) const {
+    if (empty()) return *this;
+    auto newCenter{glm::fvec3(transform * glm::fvec4(center(), 1.0f))};
+    auto linear{glm::fmat3(transform)};
+    for (int i{0}; i < 3; i++) linear[i] = glm::abs(linear[i]);
+    auto newExtent{linear * extent()};
+    return {newCenter - newExtent, newCenter + newExtent};
+}
+
+Frustum::Frustum(const glm::fmat4& viewProjection) {
+    auto rows{glm::transpose(viewProjection)};
+    for (int i{0}; i < 6; i++) {
+        auto plane{i % 2 ? rows[3] - rows[i / 2] : rows[3] + rows[i / 2]};
+        plane /= glm::length(glm::fvec3(plane));
+        x[i] = plane.x;
+        y[i] = plane.y;
+        z[i] = plane.z;
+        w[i] = plane.w;
+    }
+    for (int i{6}; i < lanes; i++) {
+        x[i] = y[i] = z[i] = 0.0f;
+        w[i] = std::numeric_limits<float>::max();
+    }
+}
+
+bool Frustum::intersects(const glm::fvec3& center, float radius) const {
+    bool outside{false};
+    for (int i{0}; i < lanes; i++)
+        outside |= x[i] * center.x + y[i] * center.y + z[i] * center.z + w[i] < -radius;
+    return !outside;
+}
+
+bool Frustum::intersects(const Aabb& box) const {
+    if (box.empty()) return false;
+    auto center{box.center()}, extent{box.extent()};
+    bool outside{false};
+    for (int i{0}; i < lanes; i++) {
+        auto distance{x[i] * center.x + y[i] * center.y + z[i] * center.z + w[i]};
+        auto reach{std::abs(x[i]) * extent.x + std::abs(y[i]) * extent.y +
+                   std::abs(z[i]) * extent.z};
+        outside |= distance + reach < 0.0f;
+    }
+    return !outside;
+}
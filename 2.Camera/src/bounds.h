@@ -0,0 +1,57 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <limits>
+
+// Axis aligned bounding box; empty (low above high) until something is added.
+struct Aabb {
+    glm::fvec3 low{std::numeric_limits<float>::max()};
+    glm::fvec3 high{std::numeric_limits<float>::lowest()};
+
+    void add(const glm::fvec3& point);
+    void add(const Aabb& box);
+    bool empty() const;
+    glm::fvec3 center() const;
+    glm::fvec3 extent() const;
+    // the box around this one after the affine `transform` (Arvo): the center moves, the extent
+    // goes through the absolute value of the linear part
+    Aabb transformed(const glm::fmat4& transform) const;
+};
+
+// The six planes of a view-projection matrix (Gribb and Hartmann), normalized and pointing
+// inwards, in the space the matrix projects from. They are kept as a structure of arrays padded
+// to eight lanes with two that pass everything, so a test is a branch-free loop over all planes
+// that the compiler vectorizes.
+class Frustum {
+public:
+    explicit Frustum(const glm::fmat4& viewProjection);
+
+    // false only when the sphere is entirely outside one of the planes
+    bool intersects(const glm::fvec3& center, float radius) const;
+    // false only when the box is entirely outside one of the planes: its corner furthest along
+    // the plane normal is behind it
+    bool intersects(const Aabb& box) const;
+
+private:
+    static constexpr int lanes{8};
+    alignas(32) std::array<float, lanes> x, y, z, w;
+};
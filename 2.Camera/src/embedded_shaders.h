@@ -0,0 +1,25 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string_view>
+
+// Source of the shader file `name` (e.g. "skeletal.vert") as it was at build time, with
+// #include resolved and comments stripped; nullptr if no such shader was embedded. The table
+// is generated by tools/embed_shaders.cpp, so no shader file is read at startup.
+const char* embeddedShader(std::string_view name);
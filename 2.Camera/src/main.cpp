@@ -32,48 +32,22 @@
 #include <iostream>
 #include <numbers>
 
+#include "embedded_shaders.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
+#include "program_cache.h"
 #include "skeletal_mesh.h"
+#include "virtual_texture.h"
 
 namespace SkeletalAnimation {
-const char* vertex_shader =
-    "#version 330 core\n"
-    "const int MAX_BONES = 100;\n"
-    "uniform mat4 u_bone_transf[MAX_BONES];\n"
-    "uniform mat4 u_mvp;\n"
-    "layout(location = 0) in vec3 in_position;\n"
-    "layout(location = 1) in vec2 in_texcoord;\n"
-    "layout(location = 2) in vec3 in_normal;\n"
-    "layout(location = 3) in ivec4 in_bone_index;\n"
-    "layout(location = 4) in vec4 in_bone_weight;\n"
-    "out vec2 pass_texcoord;\n"
-    "void main() {\n"
-    "    float adjust_factor = 0.0;\n"
-    "    for (int i = 0; i < 4; i++) adjust_factor += in_bone_weight[i] * 0.25;\n"
-    "    mat4 bone_transform = mat4(1.0);\n"
-    "    if (adjust_factor > 1e-3) {\n"
-    "        bone_transform -= bone_transform;\n"
-    "        for (int i = 0; i < 4; i++)\n"
-    "            bone_transform += u_bone_transf[in_bone_index[i]] * in_bone_weight[i] / "
-    "adjust_factor;\n"
-    "	 }\n"
-    "    gl_Position = u_mvp * bone_transform * vec4(in_position, 1.0);\n"
-    "    pass_texcoord = in_texcoord;\n"
-    "}\n";
-
-const char* fragment_shader =
-    "#version 330 core\n"
-    "uniform sampler2D u_diffuse;\n"
-    "in vec2 pass_texcoord;\n"
-    "out vec4 out_color;\n"
-    "void main() {\n"
+// compile-time constants of the skeletal programs, the shader compiler unrolls the bone loops
+ShaderDefines defines() {
+    ShaderDefines result{{"MAX_BONES", "100"}, {"BONES_PER_VERTEX", "4"}};
 #ifdef DIFFUSE_TEXTURE_MAPPING
-    "    out_color = vec4(texture(u_diffuse, pass_texcoord).xyz, 1.0);\n"
-#else
-    "    out_color = vec4(pass_texcoord, 0.0, 1.0);\n"
+    result.emplace("DIFFUSE_TEXTURE_MAPPING", "1");
 #endif
-    "}\n";
+    return result;
+}
 }  // namespace SkeletalAnimation
 
 bool firstMouse{true};
@@ -93,6 +67,10 @@ float deltaTime{0.0f};
 float lastFrame{0.0f};
 
 bool enableMetacarpalsRotation{true};
+bool enableOcclusionCulling{false};
+
+const float zNear{0.1f};
+const float zFar{100.f};
 
 enum class CameraType { Normal, Start, End, Transform };
 CameraType currentCamera = CameraType::Normal;
@@ -478,50 +456,13 @@ public:
         startPoint = start;
         endPoint = end;
 
-        const char* vertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in float in_opacity;
-out float opacity;
-uniform mat4 MVP;
-void main() {
-    gl_Position = MVP * vec4(aPos.x, aPos.y, aPos.z, 1.0);
-    opacity = in_opacity;
-}
-)";
-        const char* fragmentShaderSource = R"(
-#version 330 core
-out vec4 FragColor;
-in float opacity;
-uniform vec3 color;
-void main() {
-    FragColor = vec4(color, opacity);
-}
-)";
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         glLineWidth(3.f);
-        // vertex shader
-        int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-        glCompileShader(vertexShader);
-        // check for shader compile errors
-
-        // fragment shader
-        int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-        glCompileShader(fragmentShader);
-        // check for shader compile errors
-
-        // link shaders
-        shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-        // check for linking errors
-
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        shaderProgram = ProgramCache::submit({
+            {GL_VERTEX_SHADER, embeddedShader("line.vert")},
+            {GL_FRAGMENT_SHADER, embeddedShader("line.frag")},
+        });
 
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -539,6 +480,7 @@ void main() {
     }
 
     int draw() {
+        if (!ProgramCache::ready(shaderProgram)) return 0;
         glUseProgram(shaderProgram);
         glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "MVP"), 1, GL_FALSE, &mvp[0][0]);
         glUniform3fv(glGetUniformLocation(shaderProgram, "color"), 1, &lineColor[0]);
@@ -565,6 +507,61 @@ void main() {
     }
 };
 
+// What a frame is drawn into while occlusion culling is on: color, and a depth texture the
+// culling pyramid is built from. present() copies the color to the window.
+class FrameTarget {
+    GLuint fbo, color, depth;
+    int width, height;
+
+public:
+    FrameTarget() : width{0}, height{0} {
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(1, &color);
+        glGenTextures(1, &depth);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // binds the target, reallocated first if the frame is not `w` x `h`
+    void bind(int w, int h) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        if (w == width && h == height) return;
+        width = w;
+        height = h;
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT,
+                     GL_FLOAT, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+    }
+
+    GLuint depthMap() const {
+        return depth;
+    }
+
+    // copies the color to the default framebuffer and leaves that bound
+    void present() {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                          GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~FrameTarget() {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteTextures(1, &depth);
+    }
+};
+
 glm::fvec3 startCamPos{20.f, 0.f, 0.f}, endCamPos{-20.f, 0.f, 0.f};
 glm::fvec3 startCamFront{-1.f, 0.f, 0.f}, endCamFront{1.f, 0.f, 0.f};
 float transformDuration{3.0f};
@@ -598,7 +595,7 @@ static float getRatio(float deltaTime) {
 
 int main(int argc, char* argv[]) {
     GLFWwindow* window;
-    GLuint vertex_shader, fragment_shader, program;
+    GLuint program;
 
     glfwSetErrorCallback(error_callback);
 
@@ -639,34 +636,59 @@ int main(int argc, char* argv[]) {
 
     if (glewInit() != GLEW_OK) exit(EXIT_FAILURE);
 
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &SkeletalAnimation::vertex_shader, nullptr);
-    glCompileShader(vertex_shader);
-
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &SkeletalAnimation::fragment_shader, nullptr);
-    glCompileShader(fragment_shader);
-
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
+    // submitted without waiting, the driver compiles while the scene is being loaded
+    auto checkLink{[](GLuint object, const std::string& type) {
+        int linkStatus;
+        if (type != "PROGRAM") return;
+        if (glGetProgramiv(object, GL_LINK_STATUS, &linkStatus), linkStatus == GL_FALSE)
+            std::cout << "Error occured in glLinkProgram()" << std::endl;
+    }};
+    auto vertexSource{
+        ProgramCache::specialize(embeddedShader("skeletal.vert"), SkeletalAnimation::defines())};
+    auto fragmentSource{
+        ProgramCache::specialize(embeddedShader("skeletal.frag"), SkeletalAnimation::defines())};
+    program = ProgramCache::submit(
+        {{GL_VERTEX_SHADER, vertexSource.c_str()}, {GL_FRAGMENT_SHADER, fragmentSource.c_str()}},
+        checkLink);
 
-    int linkStatus;
-    if (glGetProgramiv(program, GL_LINK_STATUS, &linkStatus), linkStatus == GL_FALSE)
-        std::cout << "Error occured in glLinkProgram()" << std::endl;
+#ifdef DIFFUSE_TEXTURE_MAPPING
+    // same vertex stage, fragment stage writes the virtual texture pages it would sample
+    GLuint feedbackProgram{
+        ProgramCache::submit({{GL_VERTEX_SHADER, vertexSource.c_str()},
+                              {GL_FRAGMENT_SHADER, embeddedShader("vt_feedback.frag")}},
+                             checkLink)};
+    VirtualTexture::Feedback vtFeedback;
+#endif
+    // occlusion culling: the pyramid levels of a frame's depth, and the boxes of its borderline
+    // mesh entries
+    GLuint hiZReduceProgram{
+        ProgramCache::submit({{GL_VERTEX_SHADER, embeddedShader("fullscreen.vert")},
+                              {GL_FRAGMENT_SHADER, embeddedShader("hiz_reduce.frag")}},
+                             checkLink)};
+    GLuint occlusionBoxProgram{
+        ProgramCache::submit({{GL_VERTEX_SHADER, embeddedShader("occlusion_box.vert")},
+                              {GL_FRAGMENT_SHADER, embeddedShader("occlusion_box.frag")}},
+                             checkLink)};
+    OcclusionCulling occlusionCulling(zNear, zFar);
+    FrameTarget frameTarget;
 
     auto sr = Scene::loadScene("Hand", "Hand.fbx");
     if (!sr.has_value()) std::cout << "Error occured in loadMesh()" << std::endl;
+    std::cout << "Texture uploads avoided by content dedup: " << Texture::uploadsAvoided
+              << std::endl;
+    std::cout << "Program binary cache: " << ProgramCache::hits << " hits, "
+              << ProgramCache::misses << " misses" << std::endl;
 
-    sr->get()->setShaderInput(program, "in_position", "in_texcoord", "in_normal", "in_bone_index",
-                              "in_bone_weight");
+    // vertex inputs are bound once the program is linked, see the render loop
+    bool sceneReady{false};
 
     Line posA({10.f, 0.f, 0.f}, {10.f, 5.f, 0.f}, {0.f, 1.f, 0.f});
     Line posB({-10.f, 0.f, 0.f}, {-10.f, 5.f, 0.f}, {1.f, 0.f, 0.f});
 
     float passed_time;
     auto metacarpalsRotation{glm::fmat4(1.0f)};
+    // of the last frame, shown by the next one
+    Scene::RenderStats sceneStats;
 
     initGesture();
 
@@ -706,6 +728,9 @@ int main(int argc, char* argv[]) {
                     transformEndQuat = glm::quat(glm::fvec3(endPitch, endYaw, 0.f));
                 }
             }
+            ImGui::Checkbox("Occlusion culling", &enableOcclusionCulling);
+            ImGui::Text("Scene: %zu draws, %zu culled, %zu occluded", sceneStats.draws,
+                        sceneStats.culled, sceneStats.occluded);
             ImGui::End();
         }
         ImGui::Render();
@@ -735,9 +760,16 @@ int main(int argc, char* argv[]) {
         glClearColor(0.5, 0.5, 0.5, 1.0);
 
         glViewport(0, 0, width, height);
+        // the window itself unless the depth is needed for occlusion culling
+        if (enableOcclusionCulling) frameTarget.bind(width, height);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(program);
+        ProgramCache::poll();
+        if (!sceneReady && ProgramCache::ready(program)) {
+            sr->get()->setShaderInput(program, "in_position", "in_texcoord", "in_normal",
+                                      "in_bone_index", "in_bone_weight");
+            sceneReady = true;
+        }
 
         glm::fmat4 lookat;
         switch (currentCamera) {
@@ -762,17 +794,56 @@ int main(int argc, char* argv[]) {
         }
 
         glm::fmat4 mvp =
-            glm::perspective(glm::radians(fov), ratio, 0.1f, 100.f) * lookat * modelRotation;
-        glUniformMatrix4fv(glGetUniformLocation(program, "u_mvp"), 1, GL_FALSE,
-                           (const GLfloat*)&mvp);
-        glUniform1i(glGetUniformLocation(program, "u_diffuse"),
-                    SCENE_RESOURCE_SHADER_DIFFUSE_CHANNEL);
-        Scene::SkeletonTransf bonesTransf;
-        sr->get()->getSkeletonTransform(bonesTransf, modifier);
-        if (!bonesTransf.empty())
-            glUniformMatrix4fv(glGetUniformLocation(program, "u_bone_transf"), bonesTransf.size(),
-                               GL_FALSE, (float*)bonesTransf.data());
-        sr->get()->render();
+            glm::perspective(glm::radians(fov), ratio, zNear, zFar) * lookat * modelRotation;
+        // the hand shows up once its program is linked
+        if (sceneReady) {
+            glUseProgram(program);
+            glUniformMatrix4fv(glGetUniformLocation(program, "u_mvp"), 1, GL_FALSE,
+                               (const GLfloat*)&mvp);
+            glUniform1i(glGetUniformLocation(program, "u_diffuse"),
+                        SCENE_RESOURCE_SHADER_DIFFUSE_CHANNEL);
+            Scene::SkeletonTransf bonesTransf;
+            sr->get()->getSkeletonTransform(bonesTransf, modifier);
+            if (!bonesTransf.empty())
+                glUniformMatrix4fv(glGetUniformLocation(program, "u_bone_transf"),
+                                   bonesTransf.size(), GL_FALSE, (float*)bonesTransf.data());
+            // mesh entries are tested against the depth of an earlier frame once its programs
+            // are linked
+            OcclusionCulling* occlusion{nullptr};
+            if (enableOcclusionCulling && ProgramCache::ready(hiZReduceProgram) &&
+                ProgramCache::ready(occlusionBoxProgram)) {
+                occlusion = &occlusionCulling;
+                occlusion->beginFrame(mvp);
+            }
+#ifdef DIFFUSE_TEXTURE_MAPPING
+            // virtual texture pages needed by this frame, read back asynchronously; nothing to
+            // do while no material uses a virtual texture
+            if (VirtualTexture::anyLoaded()) {
+                if (ProgramCache::ready(feedbackProgram)) {
+                    vtFeedback.begin(feedbackProgram, width, height);
+                    glUniformMatrix4fv(glGetUniformLocation(feedbackProgram, "u_mvp"), 1,
+                                       GL_FALSE, (const GLfloat*)&mvp);
+                    if (!bonesTransf.empty())
+                        glUniformMatrix4fv(glGetUniformLocation(feedbackProgram, "u_bone_transf"),
+                                           bonesTransf.size(), GL_FALSE,
+                                           (float*)bonesTransf.data());
+                    sr->get()->render(mvp, bonesTransf, occlusion);
+                    vtFeedback.end();
+                    if (enableOcclusionCulling) frameTarget.bind(width, height);
+                    glUseProgram(program);
+                }
+                vtFeedback.process();
+            }
+#endif
+            sceneStats = sr->get()->render(mvp, bonesTransf, occlusion);
+            // borderline entries checked against this frame's depth, which then becomes the
+            // pyramid of a later frame
+            if (occlusion) {
+                occlusion->confirm(occlusionBoxProgram);
+                occlusion->capture(hiZReduceProgram, frameTarget.depthMap(), width, height);
+                frameTarget.bind(width, height);
+            }
+        }
 
         if (currentCamera == CameraType::Normal) {
             posA.setPos(startCamPos, startCamPos + 5.f * startCamFront);
@@ -783,6 +854,7 @@ int main(int argc, char* argv[]) {
             posB.draw();
         }
 
+        if (enableOcclusionCulling) frameTarget.present();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         glfwSwapBuffers(window);
@@ -0,0 +1,258 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "mapped_image.h"
+
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& filename)
+    : view{nullptr}, length{0}, file{INVALID_HANDLE_VALUE}, mapping{nullptr} {
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return;
+    view = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (view) length = static_cast<std::size_t>(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const std::string& filename) : view{nullptr}, length{0}, fd{-1} {
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) return;
+    void* addr{mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    if (addr == MAP_FAILED) return;
+    // the whole file is consumed front to back right after mapping
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    view = static_cast<const unsigned char*>(addr);
+    length = st.st_size;
+}
+
+MappedFile::~MappedFile() {
+    if (view) munmap(const_cast<unsigned char*>(view), length);
+    if (fd >= 0) close(fd);
+}
+#endif
+
+// layout of an uncompressed image that can be copied row by row from the file
+struct RawLayout {
+    ImageInfo info;
+    GLenum format;
+    std::size_t offset;
+    std::size_t stride;
+    bool bottomUp;
+};
+
+static std::uint16_t readU16(const unsigned char* p) {
+    return p[0] | p[1] << 8;
+}
+
+static std::uint32_t readU32(const unsigned char* p) {
+    return readU16(p) | static_cast<std::uint32_t>(readU16(p + 2)) << 16;
+}
+
+static std::optional<RawLayout> parseRawBmp(const unsigned char* data, std::size_t size) {
+    // BITMAPFILEHEADER + at least BITMAPINFOHEADER
+    if (size < 54 || data[0] != 'B' || data[1] != 'M') return std::nullopt;
+    const std::uint32_t offset{readU32(data + 10)};
+    const std::uint32_t headerSize{readU32(data + 14)};
+    const auto width{static_cast<std::int32_t>(readU32(data + 18))};
+    const auto height{static_cast<std::int32_t>(readU32(data + 22))};
+    const std::uint16_t bpp{readU16(data + 28)};
+    const std::uint32_t compression{readU32(data + 30)};
+    // only BI_RGB 24-bit; palettes, bitfields and 32-bit alpha rules are left to stb
+    if (headerSize < 40 || compression != 0 || bpp != 24 || width <= 0 || height == 0)
+        return std::nullopt;
+    RawLayout layout{{width, std::abs(height), 3}, GL_BGR, offset, 0, height > 0};
+    layout.stride = (static_cast<std::size_t>(width) * 3 + 3) & ~std::size_t{3};
+    if (layout.offset + layout.stride * layout.info.height > size) return std::nullopt;
+    return layout;
+}
+
+static std::optional<RawLayout> parseRawTga(const unsigned char* data, std::size_t size) {
+    if (size < 18) return std::nullopt;
+    const unsigned char idLength{data[0]};
+    const unsigned char colorMapType{data[1]};
+    const unsigned char imageType{data[2]};
+    const int width{readU16(data + 12)};
+    const int height{readU16(data + 14)};
+    const unsigned char bpp{data[16]};
+    const unsigned char descriptor{data[17]};
+    // uncompressed true-color, left-to-right rows only
+    if (colorMapType != 0 || imageType != 2 || (bpp != 24 && bpp != 32) || (descriptor & 0x10) ||
+        width == 0 || height == 0)
+        return std::nullopt;
+    const int channels{bpp / 8};
+    RawLayout layout{{width, height, channels},
+                     channels == 4 ? GLenum{GL_BGRA} : GLenum{GL_BGR},
+                     18u + idLength,
+                     static_cast<std::size_t>(width) * channels,
+                     !(descriptor & 0x20)};
+    if (layout.offset + layout.stride * height > size) return std::nullopt;
+    return layout;
+}
+
+static GLenum internalFormat(int channels) {
+    switch (channels) {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 3: return GL_RGB;
+        default: return GL_RGBA;
+    }
+}
+
+static bool uploadRaw(const unsigned char* data, const RawLayout& layout, bool flip) {
+    const std::size_t rowBytes{static_cast<std::size_t>(layout.info.width) * layout.info.channels};
+    const std::size_t total{rowBytes * layout.info.height};
+
+    GLuint pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, total, nullptr, GL_STREAM_DRAW);
+    auto dst{static_cast<unsigned char*>(glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, total, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT))};
+    if (!dst) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pbo);
+        return false;
+    }
+    // the flip happens here: rows are written in the order the texture wants them
+    const bool reverse{layout.bottomUp != flip};
+    const unsigned char* src{data + layout.offset};
+    for (int y = 0; y < layout.info.height; y++) {
+        const int srcRow{reverse ? layout.info.height - 1 - y : y};
+        std::memcpy(dst + y * rowBytes, src + srcRow * layout.stride, rowBytes);
+    }
+    const bool unmapped{glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE};
+    if (unmapped) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(layout.info.channels), layout.info.width,
+                     layout.info.height, 0, layout.format, GL_UNSIGNED_BYTE, nullptr);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+    return unmapped;
+}
+
+std::optional<ImageInfo> uploadMappedImage(const MappedFile& file, bool flip) {
+    if (!file.valid()) return std::nullopt;
+
+    auto raw{parseRawBmp(file.data(), file.size())};
+    if (!raw) raw = parseRawTga(file.data(), file.size());
+    if (raw && uploadRaw(file.data(), *raw, flip)) return raw->info;
+
+    // compressed or exotic formats: decode from the mapping instead of going through stdio
+    stbi_set_flip_vertically_on_load(flip);
+    ImageInfo info;
+    unsigned char* pixels{stbi_load_from_memory(file.data(), static_cast<int>(file.size()),
+                                                &info.width, &info.height, &info.channels, 0)};
+    if (!pixels) return std::nullopt;
+    const GLenum format{internalFormat(info.channels)};
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, info.width, info.height, 0, format, GL_UNSIGNED_BYTE,
+                 pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    stbi_image_free(pixels);
+    return info;
+}
+
+std::optional<ImageInfo> probeMappedImage(const MappedFile& file) {
+    if (!file.valid()) return std::nullopt;
+    if (auto raw{parseRawBmp(file.data(), file.size())}) return raw->info;
+    if (auto raw{parseRawTga(file.data(), file.size())}) return raw->info;
+    ImageInfo info;
+    if (!stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &info.width,
+                               &info.height, &info.channels))
+        return std::nullopt;
+    return info;
+}
+
+MappedPixels::MappedPixels(const MappedFile& file)
+    : base{nullptr},
+      stride{0},
+      channels{0},
+      bgr{false},
+      bottomUp{true},
+      decoded{nullptr},
+      imageInfo{0, 0, 0} {
+    if (!file.valid()) return;
+    auto raw{parseRawBmp(file.data(), file.size())};
+    if (!raw) raw = parseRawTga(file.data(), file.size());
+    if (raw) {
+        base = file.data() + raw->offset;
+        stride = raw->stride;
+        channels = raw->info.channels;
+        bgr = true;
+        bottomUp = raw->bottomUp;
+        imageInfo = raw->info;
+        return;
+    }
+    stbi_set_flip_vertically_on_load(true);
+    decoded = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &imageInfo.width,
+                                    &imageInfo.height, &imageInfo.channels, 0);
+    if (!decoded) return;
+    base = decoded;
+    channels = imageInfo.channels;
+    stride = static_cast<std::size_t>(imageInfo.width) * channels;
+}
+
+MappedPixels::~MappedPixels() {
+    if (decoded) stbi_image_free(decoded);
+}
+
+void MappedPixels::texel(int x, int y, unsigned char* out) const {
+    const int row{bottomUp ? y : imageInfo.height - 1 - y};
+    const unsigned char* p{base + row * stride + static_cast<std::size_t>(x) * channels};
+    switch (channels) {
+        case 1: out[0] = out[1] = out[2] = p[0], out[3] = 255; break;
+        case 2: out[0] = out[1] = out[2] = p[0], out[3] = p[1]; break;
+        case 3:
+            out[0] = p[bgr ? 2 : 0], out[1] = p[1], out[2] = p[bgr ? 0 : 2], out[3] = 255;
+            break;
+        default:
+            out[0] = p[bgr ? 2 : 0], out[1] = p[1], out[2] = p[bgr ? 0 : 2], out[3] = p[3];
+            break;
+    }
+}
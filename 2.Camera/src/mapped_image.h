@@ -0,0 +1,97 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+    const unsigned char* view;
+    std::size_t length;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#else
+    int fd;
+#endif
+
+public:
+    explicit MappedFile(const std::string& filename);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool valid() const {
+        return view != nullptr;
+    }
+    const unsigned char* data() const {
+        return view;
+    }
+    std::size_t size() const {
+        return length;
+    }
+};
+
+struct ImageInfo {
+    int width;
+    int height;
+    int channels;
+};
+
+// Reads only the image header: size and channel count without decoding any pixels.
+std::optional<ImageInfo> probeMappedImage(const MappedFile& file);
+
+// CPU-side access to the pixels of a mapped image. Uncompressed BMP/TGA rows are read in place
+// from the mapping; other formats are decoded once by stb. Rows are addressed bottom-up, the
+// same way as texture rows, and always expanded to RGBA.
+class MappedPixels {
+private:
+    const unsigned char* base;
+    std::size_t stride;
+    int channels;
+    bool bgr;
+    bool bottomUp;
+    unsigned char* decoded;
+    ImageInfo imageInfo;
+
+public:
+    explicit MappedPixels(const MappedFile& file);
+    MappedPixels(const MappedPixels&) = delete;
+    MappedPixels& operator=(const MappedPixels&) = delete;
+    ~MappedPixels();
+
+    bool valid() const {
+        return base != nullptr;
+    }
+    const ImageInfo& info() const {
+        return imageInfo;
+    }
+    // copies texel (x, y) as RGBA into `out`
+    void texel(int x, int y, unsigned char* out) const;
+};
+
+// Decodes the mapped image into level 0 of the texture currently bound to GL_TEXTURE_2D.
+// Uncompressed BMP/TGA rows are copied straight from the mapping into a mapped pixel unpack
+// buffer; other formats go through stbi_load_from_memory. With `flip` set the last image row
+// becomes the first texture row, as OpenGL texture coordinates expect.
+std::optional<ImageInfo> uploadMappedImage(const MappedFile& file, bool flip);
@@ -0,0 +1,304 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+OcclusionCulling::OcclusionCulling(float zNear, float zFar) : zNear{zNear}, zFar{zFar} {
+    // unit cube around the origin
+    // clang-format off
+    const std::array corners{
+        -1.f, -1.f, -1.f,  1.f, -1.f, -1.f,  1.f, 1.f, -1.f,  -1.f, 1.f, -1.f,
+        -1.f, -1.f,  1.f,  1.f, -1.f,  1.f,  1.f, 1.f,  1.f,  -1.f, 1.f,  1.f,
+    };
+    const std::array<GLuint, 36> faces{
+        0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+        3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5,
+    };
+    // clang-format on
+    glGenVertexArrays(1, &cubeVao);
+    glGenBuffers(1, &cubeVbo);
+    glGenBuffers(1, &cubeEbo);
+    glBindVertexArray(cubeVao);
+    glBindBuffer(GL_ARRAY_BUFFER, cubeVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cubeEbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glGenVertexArrays(1, &emptyVao);
+
+    glGenTextures(1, &pyramid);
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    // read with texelFetch only, one level at a time
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(2, pbo.data());
+}
+
+OcclusionCulling::~OcclusionCulling() {
+    for (auto sync : fence)
+        if (sync) glDeleteSync(sync);
+    for (auto& [key, entry] : entries)
+        if (entry.query) glDeleteQueries(1, &entry.query);
+    glDeleteVertexArrays(1, &cubeVao);
+    glDeleteBuffers(1, &cubeVbo);
+    glDeleteBuffers(1, &cubeEbo);
+    glDeleteVertexArrays(1, &emptyVao);
+    glDeleteFramebuffers(levelFbos.size(), levelFbos.data());
+    glDeleteTextures(1, &pyramid);
+    glDeleteBuffers(2, pbo.data());
+}
+
+void OcclusionCulling::beginFrame(const glm::fmat4& mvp) {
+    this->mvp = mvp;
+    frame++;
+    borderline.clear();
+    update();
+}
+
+bool OcclusionCulling::visible(const void* key, const Aabb& box) {
+    auto& entry{entries[key]};
+    if (entry.frame == frame) return entry.visible;
+    entry.frame = frame;
+    // the query of the last time it was borderline, if it is done
+    if (entry.queried) {
+        GLuint available{0};
+        glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint passed{0};
+            glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &passed);
+            if (passed) entry.confirmedUntil = frame + confirmedFrames;
+            entry.queried = false;
+        }
+    }
+    const Verdict verdict{test(box)};
+    entry.visible = verdict == Verdict::Visible || frame < entry.confirmedUntil;
+    if (!entry.visible && verdict == Verdict::Borderline && !entry.queried) {
+        entry.box = box;
+        borderline.push_back(&entry);
+    }
+    return entry.visible;
+}
+
+void OcclusionCulling::confirm(GLuint boxProgram) {
+    if (borderline.empty()) return;
+    // depth test only; a flat box lies exactly on the surface it bounds
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    glUseProgram(boxProgram);
+    const GLint mvpLocation{glGetUniformLocation(boxProgram, "u_mvp")};
+    glBindVertexArray(cubeVao);
+    for (auto entry : borderline) {
+        if (!entry->query) glGenQueries(1, &entry->query);
+        const glm::fmat4 boxMvp{
+            glm::scale(glm::translate(mvp, entry->box.center()), entry->box.extent())};
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, &boxMvp[0][0]);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, entry->query);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        entry->queried = true;
+    }
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void OcclusionCulling::capture(GLuint reduceProgram, GLuint depthMap, int width, int height) {
+    resize(width, height);
+    GLint previousViewport[4];
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(reduceProgram);
+    glUniform1i(glGetUniformLocation(reduceProgram, "u_source"), 0);
+    glBindVertexArray(emptyVao);
+    // each level from the one before, the first from the depth; only the source level is in
+    // the pyramid's level range while its next one is drawn
+    glActiveTexture(GL_TEXTURE0);
+    for (int level = 0; level <= readLevel; level++) {
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, depthMap);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, pyramid);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, levelFbos[level]);
+        glViewport(0, 0, levelSizes[level].x, levelSizes[level].y);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, readLevel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+
+    // a readback that never got taken in is simply replaced
+    if (fence[slot]) glDeleteSync(fence[slot]);
+    const glm::uvec2 size{levelSizes[readLevel]};
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size.x * size.y * sizeof(float), nullptr, GL_STREAM_READ);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, size.x, size.y, GL_RED, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2],
+               previousViewport[3]);
+    fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readMvp[slot] = mvp;
+    readDepthSize[slot] = glm::uvec2(width, height);
+    readSize[slot] = size;
+    readShift[slot] = readLevel + 1;
+    slot ^= 1;
+}
+
+void OcclusionCulling::resize(int width, int height) {
+    if (width == depthWidth && height == depthHeight) return;
+    depthWidth = width;
+    depthHeight = height;
+    // halve until both sides fit the readback
+    levelSizes.clear();
+    glm::uvec2 size(std::max(width / 2, 1), std::max(height / 2, 1));
+    levelSizes.push_back(size);
+    while (size.x > readbackSize || size.y > readbackSize) {
+        size = glm::max(size / 2u, glm::uvec2(1u));
+        levelSizes.push_back(size);
+    }
+    readLevel = static_cast<int>(levelSizes.size()) - 1;
+
+    glBindTexture(GL_TEXTURE_2D, pyramid);
+    for (int level = 0; level <= readLevel; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelSizes[level].x, levelSizes[level].y, 0,
+                     GL_RED, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, readLevel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteFramebuffers(levelFbos.size(), levelFbos.data());
+    levelFbos.resize(levelSizes.size());
+    glGenFramebuffers(levelFbos.size(), levelFbos.data());
+    for (int level = 0; level <= readLevel; level++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, levelFbos[level]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid,
+                               level);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OcclusionCulling::update() {
+    // the older readback; the newer one is taken in by a later frame
+    const int older{slot};
+    auto& sync{fence[older]};
+    if (!sync) return;
+    const GLenum status{glClientWaitSync(sync, 0, 0)};
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+    glDeleteSync(sync);
+    sync = nullptr;
+
+    glm::uvec2 size{readSize[older]};
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[older]);
+    if (auto data{static_cast<const float*>(glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, size.x * size.y * sizeof(float), GL_MAP_READ_BIT))}) {
+        levels.assign(1, std::vector<float>(data, data + size.x * size.y));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        cpuSizes.assign(1, size);
+        cpuMvp = readMvp[older];
+        cpuDepthSize = readDepthSize[older];
+        cpuShift = readShift[older];
+        // the rest of the pyramid, as hiz_reduce.frag does it: the last texel of an odd side
+        // takes in the extra column or row
+        while (size.x > 1 || size.y > 1) {
+            const auto& source{levels.back()};
+            const glm::uvec2 next{std::max(size.x / 2, 1u), std::max(size.y / 2, 1u)};
+            std::vector<float> reduced(next.x * next.y, 0.f);
+            for (unsigned y = 0; y < size.y; y++) {
+                const unsigned ny{std::min(y / 2, next.y - 1)};
+                for (unsigned x = 0; x < size.x; x++) {
+                    auto& farthest{reduced[ny * next.x + std::min(x / 2, next.x - 1)]};
+                    farthest = std::max(farthest, source[y * size.x + x]);
+                }
+            }
+            levels.push_back(std::move(reduced));
+            cpuSizes.push_back(next);
+            size = next;
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+OcclusionCulling::Verdict OcclusionCulling::test(const Aabb& box) const {
+    if (levels.empty() || box.empty()) return Verdict::Visible;
+    // screen rectangle and nearest depth of the box, as the pyramid's frame saw it
+    glm::fvec2 low{1.f}, high{-1.f};
+    float nearest{1.f};
+    for (int corner = 0; corner < 8; corner++) {
+        const glm::fvec3 point{corner & 1 ? box.high.x : box.low.x,
+                               corner & 2 ? box.high.y : box.low.y,
+                               corner & 4 ? box.high.z : box.low.z};
+        const glm::fvec4 clip{cpuMvp * glm::fvec4(point, 1.f)};
+        // reaches behind the camera
+        if (clip.w <= zNear) return Verdict::Visible;
+        const glm::fvec3 ndc{glm::fvec3(clip) / clip.w};
+        low = glm::min(low, glm::fvec2(ndc));
+        high = glm::max(high, glm::fvec2(ndc));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+    low = glm::clamp(low, -1.f, 1.f);
+    high = glm::clamp(high, -1.f, 1.f);
+    if (low.x >= high.x || low.y >= high.y) return Verdict::Visible;
+
+    // pixels of the depth the pyramid was built from
+    auto toPixel{[&](const glm::fvec2& ndc) {
+        const glm::fvec2 pixel{(ndc * 0.5f + 0.5f) * glm::fvec2(cpuDepthSize)};
+        return glm::min(glm::uvec2(pixel), cpuDepthSize - 1u);
+    }};
+    const glm::uvec2 first{toPixel(low)}, last{toPixel(high)};
+    // the finest level where the rectangle spans at most two texels a side; the last texel of
+    // an odd side covers the rest of it
+    auto texel{[&](glm::uvec2 pixel, std::size_t l) {
+        return glm::min(pixel >> glm::uvec2(cpuShift + static_cast<int>(l)), cpuSizes[l] - 1u);
+    }};
+    std::size_t level{0};
+    while (level + 1 < levels.size()) {
+        const glm::uvec2 span{texel(last, level) - texel(first, level)};
+        if (span.x <= 1 && span.y <= 1) break;
+        level++;
+    }
+    const glm::uvec2 from{texel(first, level)}, to{texel(last, level)};
+    float farthest{0.f};
+    for (unsigned y = from.y; y <= to.y; y++) {
+        for (unsigned x = from.x; x <= to.x; x++)
+            farthest = std::max(farthest, levels[level][y * cpuSizes[level].x + x]);
+    }
+    if (nearest <= farthest) return Verdict::Visible;
+    return linearDepth(nearest) - linearDepth(farthest) < borderlineDistance ? Verdict::Borderline
+                                                                             : Verdict::Hidden;
+}
+
+float OcclusionCulling::linearDepth(float depth) const {
+    const float ndc{depth * 2.f - 1.f};
+    return 2.f * zNear * zFar / (zFar + zNear - ndc * (zFar - zNear));
+}
@@ -0,0 +1,120 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "bounds.h"
+
+// Occlusion culling of the scene against the depth of an earlier frame. After a frame is drawn
+// its depth is reduced on the GPU to a pyramid of farthest depths (hiz_reduce.frag) down to a
+// level of at most readbackSize texels a side; that level is read back through a pixel pack
+// buffer without waiting and reduced the rest of the way on the CPU. A draw is hidden when the
+// nearest depth of its box lies behind the farthest depth under the box's screen rectangle, at
+// the level where the rectangle spans at most two texels. Boxes are projected with the mvp the
+// pyramid was drawn with, not this frame's.
+//
+// The pyramid is a frame or two old, so a draw hidden by a thin margin is borderline: it is
+// skipped, and its box is drawn under a GL_ANY_SAMPLES_PASSED query against this frame's depth.
+// The result is read a frame later, only if it is available; if any sample passed, the draw is
+// made for a few frames whatever the pyramid says.
+class OcclusionCulling {
+public:
+    // side of the largest pyramid level read back
+    static constexpr unsigned readbackSize{128};
+    // how far behind its occluders, in view distance, a hidden draw is not borderline
+    static constexpr float borderlineDistance{1.0f};
+    // frames a draw confirmed by its query is made regardless of the pyramid
+    static constexpr unsigned confirmedFrames{4};
+
+    // `zNear` and `zFar` of the camera projection
+    OcclusionCulling(float zNear, float zFar);
+    OcclusionCulling(const OcclusionCulling&) = delete;
+    ~OcclusionCulling();
+
+    // starts the tests of a frame whose boxes `mvp` projects, taking in a finished readback
+    void beginFrame(const glm::fmat4& mvp);
+    // whether the draw `key`, a stable address of the caller's, with the box `box` may be
+    // visible; every pass of a frame gets the first answer
+    bool visible(const void* key, const Aabb& box);
+    // queries of this frame's borderline draws against the depth of the bound framebuffer;
+    // `boxProgram` (occlusion_box.vert) draws a unit cube through its u_mvp
+    void confirm(GLuint boxProgram);
+    // builds the pyramid of `depthMap`, the `width` x `height` depth of this frame, with
+    // `reduceProgram` (fullscreen.vert, hiz_reduce.frag) and starts its readback; leaves the
+    // default framebuffer bound
+    void capture(GLuint reduceProgram, GLuint depthMap, int width, int height);
+
+private:
+    struct Entry {
+        Aabb box;
+        GLuint query{0};
+        // the query is in flight
+        bool queried{false};
+        unsigned confirmedUntil{0};
+        unsigned frame{0};
+        bool visible{true};
+    };
+    enum class Verdict { Visible, Hidden, Borderline };
+
+    float zNear, zFar;
+    unsigned frame{1};
+    // this frame's, for the boxes of the queries and the next capture
+    glm::fmat4 mvp{1.0f};
+    std::unordered_map<const void*, Entry> entries;
+    std::vector<Entry*> borderline;
+    GLuint cubeVao, cubeVbo, cubeEbo;
+    // attributeless fullscreen triangle
+    GLuint emptyVao;
+
+    // GPU pyramid, level 0 at half the depth's size, down to readLevel
+    GLuint pyramid;
+    std::vector<GLuint> levelFbos;
+    int depthWidth{0}, depthHeight{0};
+    int readLevel{0};
+    std::vector<glm::uvec2> levelSizes;
+
+    // readback, double buffered; each slot with the mvp, depth size and read level it was taken
+    // at
+    std::array<GLuint, 2> pbo;
+    std::array<GLsync, 2> fence{};
+    std::array<glm::fmat4, 2> readMvp{};
+    std::array<glm::uvec2, 2> readDepthSize{};
+    std::array<glm::uvec2, 2> readSize{};
+    std::array<int, 2> readShift{};
+    int slot{0};
+
+    // CPU pyramid, finest (the level read back) first, each row major from the bottom row
+    std::vector<std::vector<float>> levels;
+    std::vector<glm::uvec2> cpuSizes;
+    // the mvp and depth size it comes from, and how many halvings lie between that and
+    // levels[0]
+    glm::fmat4 cpuMvp{1.0f};
+    glm::uvec2 cpuDepthSize{0};
+    int cpuShift{0};
+
+    void resize(int width, int height);
+    void update();
+    Verdict test(const Aabb& box) const;
+    float linearDepth(float depth) const;
+};
@@ -0,0 +1,258 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "program_cache.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+std::string ProgramCache::directory{"./shader_cache"};
+std::size_t ProgramCache::hits{0};
+std::size_t ProgramCache::misses{0};
+std::map<GLuint, ProgramCache::Pending> ProgramCache::pending;
+std::map<std::string, GLuint> ProgramCache::uniformBlocks;
+
+namespace {
+
+constexpr std::uint32_t blobMagic{0x4e494250};  // "PBIN"
+
+// GL_COMPLETION_STATUS_KHR, same value for the ARB extension
+constexpr GLenum completionStatus{0x91B1};
+using MaxShaderCompilerThreads = void(APIENTRY*)(GLuint count);
+
+// FNV-1a; the key only has to be stable across launches
+std::uint64_t hashBytes(std::uint64_t h, const void* data, std::size_t size) {
+    auto bytes{static_cast<const unsigned char*>(data)};
+    for (std::size_t i{0}; i < size; i++) h = (h ^ bytes[i]) * 0x100000001b3ull;
+    return h;
+}
+
+// the terminating zero is hashed as well, so ("ab", "c") and ("a", "bc") differ
+std::uint64_t hashString(std::uint64_t h, const char* str) {
+    if (!str) str = "";
+    return hashBytes(h, str, std::strlen(str) + 1);
+}
+
+const char* stageName(GLenum type) {
+    switch (type) {
+    case GL_VERTEX_SHADER: return "VERTEX";
+    case GL_GEOMETRY_SHADER: return "GEOMETRY";
+    case GL_FRAGMENT_SHADER: return "FRAGMENT";
+    default: return "SHADER";
+    }
+}
+
+}  // namespace
+
+bool ProgramCache::supported() {
+    static const bool available{[] {
+        if (!glProgramBinary || !glGetProgramBinary || !glProgramParameteri) return false;
+        GLint formats{0};
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }()};
+    return available;
+}
+
+GLuint ProgramCache::loadBinary(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return 0;
+    std::uint32_t magic{0};
+    GLenum format{0};
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    if (!file || magic != blobMagic) return 0;
+    std::vector<char> blob{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    if (blob.empty()) return 0;
+
+    GLuint program{glCreateProgram()};
+    glProgramBinary(program, format, blob.data(), static_cast<GLsizei>(blob.size()));
+    GLint linked{GL_FALSE};
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        // driver update or a different GPU; the blob is overwritten after recompiling
+        std::cout << "Program binary " << path.string() << " rejected, recompiling" << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ProgramCache::storeBinary(GLuint program, const std::filesystem::path& path) {
+    GLint length{0};
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> blob(length);
+    GLenum format{0};
+    glGetProgramBinary(program, length, &length, &format, blob.data());
+    if (length <= 0) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    // written aside and renamed, so a crash never leaves a truncated blob behind
+    auto temporary{path};
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file.write(reinterpret_cast<const char*>(&blobMagic), sizeof(blobMagic));
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(blob.data(), length);
+        if (!file) return;
+    }
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) std::filesystem::remove(temporary, ec);
+}
+
+bool ProgramCache::parallel() {
+    // looked up through GLFW, the loader does not have to know the extension
+    static const bool available{[] {
+        for (auto [extension, function] :
+             {std::pair{"GL_KHR_parallel_shader_compile", "glMaxShaderCompilerThreadsKHR"},
+              std::pair{"GL_ARB_parallel_shader_compile", "glMaxShaderCompilerThreadsARB"}}) {
+            if (!glfwExtensionSupported(extension)) continue;
+            if (auto maxThreads{reinterpret_cast<MaxShaderCompilerThreads>(
+                    glfwGetProcAddress(function))})
+                maxThreads(0xFFFFFFFF);  // let the driver pick
+            return true;
+        }
+        return false;
+    }()};
+    return available;
+}
+
+GLuint ProgramCache::submit(std::initializer_list<ShaderStage> stages, const Check& check) {
+    auto cached{supported()};
+    parallel();
+    std::filesystem::path blobPath;
+    if (cached) {
+        auto h{0xcbf29ce484222325ull};
+        for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+            h = hashString(h, reinterpret_cast<const char*>(glGetString(name)));
+        for (auto& [type, source] : stages) {
+            h = hashBytes(h, &type, sizeof(type));
+            h = hashString(h, source);
+        }
+        char filename[24];
+        std::snprintf(filename, sizeof(filename), "%016llx.bin",
+                      static_cast<unsigned long long>(h));
+        blobPath = std::filesystem::path(directory) / filename;
+        if (auto program{loadBinary(blobPath)}) {
+            hits++;
+            applyUniformBlocks(program);
+            return program;
+        }
+    }
+    misses++;
+
+    // no status query in here, that would wait for the compiler
+    GLuint program{glCreateProgram()};
+    Pending job{{}, cached ? blobPath : std::filesystem::path{}, check};
+    for (auto& [type, source] : stages) {
+        GLuint shader{glCreateShader(type)};
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        glAttachShader(program, shader);
+        job.shaders.emplace_back(shader, stageName(type));
+    }
+    if (cached) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    pending.emplace(program, std::move(job));
+    return program;
+}
+
+void ProgramCache::finish(std::map<GLuint, Pending>::iterator it) {
+    auto& [program, job] = *it;
+    for (auto [shader, name] : job.shaders) {
+        if (job.check) job.check(shader, name);
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    if (job.check) job.check(program, "PROGRAM");
+
+    GLint linked{GL_FALSE};
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked == GL_TRUE) applyUniformBlocks(program);
+    if (!job.blobPath.empty() && linked == GL_TRUE) storeBinary(program, job.blobPath);
+    pending.erase(it);
+}
+
+bool ProgramCache::ready(GLuint program) {
+    auto it{pending.find(program)};
+    if (it == pending.end()) return true;
+    if (parallel()) {
+        GLint done{GL_FALSE};
+        glGetProgramiv(program, completionStatus, &done);
+        if (done == GL_FALSE) return false;
+    }
+    finish(it);
+    return true;
+}
+
+void ProgramCache::poll() {
+    for (auto it{pending.begin()}; it != pending.end();) ready((it++)->first);
+}
+
+GLuint ProgramCache::link(std::initializer_list<ShaderStage> stages, const Check& check) {
+    auto program{submit(stages, check)};
+    if (auto it{pending.find(program)}; it != pending.end()) finish(it);
+    return program;
+}
+
+GLuint ProgramCache::placeholder() {
+    static const GLuint program{link({
+        {GL_VERTEX_SHADER, "#version 330 core\nvoid main() { gl_Position = vec4(0.0); }\n"},
+        {GL_FRAGMENT_SHADER, "#version 330 core\nvoid main() {}\n"},
+    })};
+    return program;
+}
+
+void ProgramCache::bindUniformBlock(const std::string& name, GLuint binding) {
+    uniformBlocks.insert_or_assign(name, binding);
+}
+
+void ProgramCache::applyUniformBlocks(GLuint program) {
+    for (auto& [name, binding] : uniformBlocks) {
+        if (auto index{glGetUniformBlockIndex(program, name.c_str())}; index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, binding);
+    }
+}
+
+std::string ProgramCache::specialize(std::string_view source, const ShaderDefines& defines) {
+    if (defines.empty()) return std::string(source);
+    // #version has to stay the first directive
+    std::size_t at{0};
+    if (auto version{source.find("#version")}; version != std::string_view::npos) {
+        at = source.find('\n', version);
+        at = at == std::string_view::npos ? source.size() : at + 1;
+    }
+    std::string result(source.substr(0, at));
+    if (!result.empty() && result.back() != '\n') result += '\n';
+    for (auto& [name, value] : defines) result += "#define " + name + " " + value + "\n";
+    auto nextLine{std::count(source.begin(), source.begin() + at, '\n') + 1};
+    result += "#line " + std::to_string(nextLine) + "\n";
+    result += source.substr(at);
+    return result;
+}
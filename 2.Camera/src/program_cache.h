@@ -0,0 +1,92 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct ShaderStage {
+    GLenum type;
+    const char* source;
+};
+
+// preprocessor symbols of a shader variant, e.g. {{"RSM_SAMPLE_NUM", "64"}}; ordered, so equal
+// sets compare equal and can key a variant cache
+using ShaderDefines = std::map<std::string, std::string>;
+
+// Keeps linked programs on disk as glGetProgramBinary blobs, keyed by the stage sources and the
+// GL_VENDOR/GL_RENDERER/GL_VERSION strings, so later launches skip compiling and linking.
+//
+// Programs are submitted without waiting for the driver: submit() everything first, then ask
+// ready() every frame. With GL_KHR_parallel_shader_compile the driver compiles on its own
+// threads and ready() never blocks; without it ready() finishes the program on the spot.
+class ProgramCache {
+public:
+    // receives every compiled shader ("VERTEX", "FRAGMENT", ...) and the linked program
+    // ("PROGRAM") when the program is built from source
+    using Check = std::function<void(GLuint object, const std::string& type)>;
+
+    static std::string directory;
+    static std::size_t hits;
+    static std::size_t misses;
+
+    // Returns a program made of `stages` whose compile and link may still be in flight. A cached
+    // blob is used when the driver accepts it; otherwise the sources are compiled and the result
+    // is stored for the next launch once it is ready.
+    static GLuint submit(std::initializer_list<ShaderStage> stages, const Check& check = {});
+    // true once `program` finished linking (successfully or not); status queries, `check` and
+    // the blob write happen here
+    static bool ready(GLuint program);
+    // advances every submitted program that is done
+    static void poll();
+    // submit() and wait for it
+    static GLuint link(std::initializer_list<ShaderStage> stages, const Check& check = {});
+    // program that draws nothing, bound in place of one that is not ready yet
+    static GLuint placeholder();
+    // every program linked from now on gets its uniform block `name` bound to `binding`;
+    // GL 3.3 has no layout(binding = N) for blocks
+    static void bindUniformBlock(const std::string& name, GLuint binding);
+    // `source` with `defines` inserted right after its #version line, so loop bounds and feature
+    // switches become compile-time constants; line numbers in compile errors are preserved
+    static std::string specialize(std::string_view source, const ShaderDefines& defines);
+
+private:
+    struct Pending {
+        std::vector<std::pair<GLuint, const char*>> shaders;
+        std::filesystem::path blobPath;
+        Check check;
+    };
+    static std::map<GLuint, Pending> pending;
+    static std::map<std::string, GLuint> uniformBlocks;
+
+    static bool supported();
+    static bool parallel();
+    static void finish(std::map<GLuint, Pending>::iterator it);
+    static void applyUniformBlocks(GLuint program);
+    static GLuint loadBinary(const std::filesystem::path& path);
+    static void storeBinary(GLuint program, const std::filesystem::path& path);
+};
@@ -0,0 +1,19 @@
+#version 330 core
+// one level of the occlusion culling pyramid, see occlusion_culling.h: the farthest depth of
+// the 2x2 source texels under this texel, and of the extra column or row the last texel of an
+// odd source side takes in
+uniform sampler2D u_source;  // the level before, or the depth of the frame for the first level
+out float out_depth;
+void main() {
+    ivec2 size = textureSize(u_source, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    float farthest = 0.0;
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 3; x++) {
+            ivec2 texel = base + ivec2(x, y);
+            if ((x < 2 || texel.x == size.x - 1) && (y < 2 || texel.y == size.y - 1))
+                farthest = max(farthest, texelFetch(u_source, min(texel, size - 1), 0).r);
+        }
+    }
+    out_depth = farthest;
+}
@@ -0,0 +1,7 @@
+#version 330 core
+out vec4 FragColor;
+in float opacity;
+uniform vec3 color;
+void main() {
+    FragColor = vec4(color, opacity);
+}
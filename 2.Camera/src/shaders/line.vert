@@ -0,0 +1,9 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in float in_opacity;
+out float opacity;
+uniform mat4 MVP;
+void main() {
+    gl_Position = MVP * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    opacity = in_opacity;
+}
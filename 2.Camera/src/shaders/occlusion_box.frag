@@ -0,0 +1,4 @@
+#version 330 core
+// depth test only, under a GL_ANY_SAMPLES_PASSED query with color writes off
+void main() {
+}
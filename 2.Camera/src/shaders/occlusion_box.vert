@@ -0,0 +1,7 @@
+#version 330 core
+// u_mvp takes the unit cube to a mesh entry's box, see occlusion_culling.h
+uniform mat4 u_mvp;
+layout(location = 0) in vec3 in_position;
+void main() {
+    gl_Position = u_mvp * vec4(in_position, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+uniform sampler2D u_diffuse;
+#include "virtual_texture.glsl"
+in vec2 pass_texcoord;
+out vec4 out_color;
+void main() {
+#ifdef DIFFUSE_TEXTURE_MAPPING
+    vec4 diffuse = u_vt_enabled ? vtSample(u_diffuse, pass_texcoord)
+                                : texture(u_diffuse, pass_texcoord);
+    out_color = vec4(diffuse.xyz, 1.0);
+#else
+    out_color = vec4(pass_texcoord, 0.0, 1.0);
+#endif
+}
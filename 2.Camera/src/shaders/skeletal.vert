@@ -0,0 +1,30 @@
+#version 330 core
+// both are injected by SkeletalAnimation::defines(), so the bone loops get unrolled
+#ifndef MAX_BONES
+#define MAX_BONES 100
+#endif
+#ifndef BONES_PER_VERTEX
+#define BONES_PER_VERTEX 4
+#endif
+
+uniform mat4 u_bone_transf[MAX_BONES];
+uniform mat4 u_mvp;
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec2 in_texcoord;
+layout(location = 2) in vec3 in_normal;
+layout(location = 3) in ivec4 in_bone_index;
+layout(location = 4) in vec4 in_bone_weight;
+out vec2 pass_texcoord;
+void main() {
+    float adjust_factor = 0.0;
+    for (int i = 0; i < BONES_PER_VERTEX; i++)
+        adjust_factor += in_bone_weight[i] / float(BONES_PER_VERTEX);
+    mat4 bone_transform = mat4(1.0);
+    if (adjust_factor > 1e-3) {
+        bone_transform -= bone_transform;
+        for (int i = 0; i < BONES_PER_VERTEX; i++)
+            bone_transform += u_bone_transf[in_bone_index[i]] * in_bone_weight[i] / adjust_factor;
+    }
+    gl_Position = u_mvp * bone_transform * vec4(in_position, 1.0);
+    pass_texcoord = in_texcoord;
+}
@@ -0,0 +1,28 @@
+// shared by the shading and the feedback programs, see virtual_texture.h. `vtSample(cache, uv)`
+// replaces `texture(cache, uv)` when `u_vt_enabled` is set.
+uniform bool u_vt_enabled;
+uniform sampler2D u_vt_indirection;
+uniform ivec2 u_vt_size;
+uniform vec4 u_vt_page; // tile size, border, cache width, cache height
+uniform int u_vt_max_level;
+uniform float u_vt_lod_bias;
+int vtLevel(vec2 uv) {
+    vec2 dx = dFdx(uv * vec2(u_vt_size)), dy = dFdy(uv * vec2(u_vt_size));
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + u_vt_lod_bias;
+    return int(clamp(floor(lod), 0.0, float(u_vt_max_level)));
+}
+vec2 vtLevelSize(int level) {
+    return vec2(max(u_vt_size >> level, ivec2(1)));
+}
+ivec2 vtPage(vec2 uv, int level) {
+    return ivec2(floor(fract(uv) * vtLevelSize(level) / u_vt_page.x));
+}
+vec4 vtSample(sampler2D cache, vec2 uv) {
+    int level = vtLevel(uv);
+    vec4 entry = texelFetch(u_vt_indirection, vtPage(uv, level), level) * 255.0;
+    int mapped = int(entry.z + 0.5);
+    vec2 inPage = fract(fract(uv) * vtLevelSize(mapped) / u_vt_page.x);
+    vec2 texel = floor(entry.xy + 0.5) * (u_vt_page.x + 2.0 * u_vt_page.y) + u_vt_page.y
+                 + inPage * u_vt_page.x;
+    return textureLod(cache, texel / u_vt_page.zw, 0.0);
+}
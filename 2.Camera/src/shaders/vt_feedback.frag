@@ -0,0 +1,12 @@
+#version 330 core
+// fragment stage of the virtual texture feedback pass, writes (page x, page y, level, texture id)
+#include "virtual_texture.glsl"
+uniform int u_vt_id;
+in vec2 pass_texcoord;
+out uvec4 out_feedback;
+void main() {
+    if (!u_vt_enabled) discard;
+    int level = vtLevel(pass_texcoord);
+    ivec2 page = vtPage(pass_texcoord, level);
+    out_feedback = uvec4(uvec2(page), uint(level), uint(u_vt_id));
+}
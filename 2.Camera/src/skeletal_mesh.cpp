@@ -19,6 +19,9 @@
 // Original Author: Yi Kangrui <yikangrui@pku.edu.cn>
 
 #include "skeletal_mesh.h"
+#include "virtual_texture.h"
+
+#include <algorithm>
 
 ParametricVertex::ParametricVertex() : position{}, texcoord{}, normal{}, boneId{}, boneWeight{} {}
 
@@ -49,6 +52,14 @@ bool Material::setDiffuse(const std::string& name, const std::string& filename)
     return (diffuse = Texture::loadTexture(name, filename)).has_value();
 }
 
+Aabb MeshEntry::posedBox(const std::vector<glm::fmat4>& boneTransf) const {
+    Aabb posed{rigidBox};
+    for (const auto& [bone, boneBox] : boneBoxes) {
+        if (bone < boneTransf.size()) posed.add(boneBox.transformed(boneTransf[bone]));
+    }
+    return posed;
+}
+
 Bone::Bone(const aiMatrix4x4& m) : localTransf(m) {}
 
 Scene::Scene() : available{false}, vao{0}, vbo{0}, ebo{0} {}
@@ -168,6 +179,35 @@ std::optional<std::shared_ptr<Scene>> Scene::loadScene(const std::string& name,
         for (int j = 0; j < nMeshFaces; j++) {
             for (int k = 0; k < 3; k++) indexAssembly.push_back(curMesh->mFaces[j].mIndices[k]);
         }
+
+        // bind pose bounds; a vertex counts as skinned when skeletal.vert blends its bones
+        auto& entry{target->meshEntry[i]};
+        std::map<unsigned int, Aabb> boneBoxes;
+        for (int j = 0; j < nMeshVertices; j++) {
+            const auto& vertex{vertexAssembly[entry.vertexOffset + j]};
+            glm::fvec3 position{vertex.position[0], vertex.position[1], vertex.position[2]};
+            entry.box.add(position);
+            float weightSum{0.f};
+            for (int k = 0; k < SCENE_RESOURCE_BONE_PER_VERTEX; k++)
+                weightSum += vertex.boneWeight[k];
+            if (weightSum / SCENE_RESOURCE_BONE_PER_VERTEX <= 1e-3f) {
+                entry.rigidBox.add(position);
+                continue;
+            }
+            for (int k = 0; k < SCENE_RESOURCE_BONE_PER_VERTEX; k++) {
+                if (vertex.boneWeight[k] > 0.f) boneBoxes[vertex.boneId[k]].add(position);
+            }
+        }
+        entry.boneBoxes.assign(boneBoxes.begin(), boneBoxes.end());
+        if (!entry.box.empty()) {
+            float radius{0.f};
+            for (int j = 0; j < nMeshVertices; j++) {
+                const auto& p{vertexAssembly[entry.vertexOffset + j].position};
+                radius = std::max(radius,
+                                  glm::length(glm::fvec3(p[0], p[1], p[2]) - entry.box.center()));
+            }
+            entry.sphere = glm::fvec4(entry.box.center(), radius);
+        }
     }
 
     std::string filepath_prefix;
@@ -331,17 +371,38 @@ bool Scene::setShaderInput(GLuint program, const std::string& posiName, const st
     return true;
 }
 
-void Scene::render() const {
-    if (!available) return;
+Scene::RenderStats Scene::render(const glm::fmat4& mvp, const SkeletonTransf& boneTransf,
+                                 OcclusionCulling* occlusion) const {
+    RenderStats stats;
+    if (!available) return stats;
+    Frustum frustum(mvp);
     glBindVertexArray(vao);
     for (int i = 0; i < meshEntry.size(); i++) {
+        const Aabb box{meshEntry[i].posedBox(boneTransf)};
+        // an entry no bone moves keeps its bind pose sphere
+        bool inside{meshEntry[i].boneBoxes.empty()
+                        ? frustum.intersects(glm::fvec3(meshEntry[i].sphere), meshEntry[i].sphere.w)
+                        : frustum.intersects(box)};
+        if (!inside) {
+            stats.culled++;
+            continue;
+        }
+        if (occlusion && !occlusion->visible(&meshEntry[i], box)) {
+            stats.occluded++;
+            continue;
+        }
+
         auto a = material[meshEntry[i].materialIndex].diffuse;
-        if (!a.has_value() || !a->get()->bind(SCENE_RESOURCE_SHADER_DIFFUSE_CHANNEL))
+        if (!a.has_value() || !a->get()->bind(SCENE_RESOURCE_SHADER_DIFFUSE_CHANNEL)) {
+            VirtualTexture::unbind();
             glBindTexture(GL_TEXTURE_2D, 0);
+        }
 
         glDrawElementsBaseVertex(GL_TRIANGLES, meshEntry[i].facetCornerNum, GL_UNSIGNED_INT,
                                  (void*)(sizeof(unsigned int) * meshEntry[i].indexOffset),
                                  meshEntry[i].vertexOffset);
+        stats.draws++;
     }
     glBindVertexArray(0);
+    return stats;
 }
\ No newline at end of file
@@ -31,6 +31,8 @@
 #include <string>
 #include <vector>
 
+#include "bounds.h"
+#include "occlusion_culling.h"
 #include "texture_image.h"
 
 #define SCENE_RESOURCE_SHADER_POSI_LOCATION 0
@@ -64,6 +66,16 @@ struct MeshEntry {
     unsigned int indexOffset;
     unsigned int vertexOffset;
     unsigned int materialIndex;
+    // bind pose bounds in model space: a box, and a sphere with the radius in w
+    Aabb box;
+    glm::fvec4 sphere{0.f};
+    // bind pose box of the vertices each bone moves, by bone index, and of those no bone moves
+    std::vector<std::pair<unsigned int, Aabb>> boneBoxes;
+    Aabb rigidBox;
+
+    // the box around the entry posed by `boneTransf`: a skinned vertex is a weighted mean of
+    // its bones' transforms of it, so it lies within the union of their transformed boxes
+    Aabb posedBox(const std::vector<glm::fmat4>& boneTransf) const;
 };
 
 struct Material {
@@ -85,6 +97,14 @@ public:
     using NameBoneMap = std::map<std::string, unsigned int>;
     static NameSceneMap allScene;
 
+    // what a render() submitted, and how many mesh entries it culled, outside the frustum or
+    // occluded
+    struct RenderStats {
+        std::size_t draws{0};
+        std::size_t culled{0};
+        std::size_t occluded{0};
+    };
+
     Scene(const Scene&) = delete;
     Scene();
     ~Scene();
@@ -125,5 +145,9 @@ public:
                         const std::string& normName, const std::string& bnidName,
                         const std::string& bnwtName);
 
-    void render() const;
+    // draws every mesh entry whose bounds, posed by `boneTransf`, intersect the frustum of
+    // `mvp`, the matrix the current program draws it with, and that `occlusion`, if given, does
+    // not find hidden; its frame must have been begun with `mvp`
+    RenderStats render(const glm::fmat4& mvp, const SkeletonTransf& boneTransf,
+                       OcclusionCulling* occlusion = nullptr) const;
 };
\ No newline at end of file
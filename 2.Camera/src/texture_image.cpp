@@ -16,10 +16,75 @@
 // along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "texture_image.h"
+#include "mapped_image.h"
+#include "virtual_texture.h"
 
-Texture::Texture() : available{false}, name{}, filename{}, width{0}, height{0}, tex{0u} {}
+#include <algorithm>
+#include <cstring>
 
+Texture::Texture()
+    : available{false}, name{}, filename{}, width{0}, height{0}, hash{0u}, tex{0u} {}
+
+Texture::HashTextureMap Texture::contentTexture{};
 Texture::NameTextureMap Texture::allTexture{};
+std::size_t Texture::uploadsAvoided{0};
+int Texture::virtualThreshold{8192};
+
+// XXH64 (https://github.com/Cyan4973/xxHash), seed 0
+std::uint64_t Texture::hashContent(const unsigned char* data, std::size_t size) {
+    constexpr std::uint64_t prime1{0x9E3779B185EBCA87ull};
+    constexpr std::uint64_t prime2{0xC2B2AE3D27D4EB4Full};
+    constexpr std::uint64_t prime3{0x165667B19E3779F9ull};
+    constexpr std::uint64_t prime4{0x85EBCA77C2B2AE63ull};
+    constexpr std::uint64_t prime5{0x27D4EB2F165667C5ull};
+    const auto rotl{[](std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }};
+    const auto read64{[](const unsigned char* p) {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }};
+    const auto read32{[](const unsigned char* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }};
+    const auto round{[&](std::uint64_t acc, std::uint64_t input) {
+        return rotl(acc + input * prime2, 31) * prime1;
+    }};
+    const auto merge{[&](std::uint64_t acc, std::uint64_t val) {
+        return (acc ^ round(0, val)) * prime1 + prime4;
+    }};
+
+    const unsigned char* p{data};
+    const unsigned char* const end{data + size};
+    std::uint64_t h;
+    if (size >= 32) {
+        std::uint64_t v1{prime1 + prime2}, v2{prime2}, v3{0}, v4{0 - prime1};
+        for (; p + 32 <= end; p += 32) {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+    } else {
+        h = prime5;
+    }
+    h += size;
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ round(0, read64(p)), 27) * prime1 + prime4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; p++) h = rotl(h ^ (*p * prime5), 11) * prime1;
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
 
 std::string Texture::testAllSuffix(const std::string& no_suffix_name) {
     for (const auto& i : {".bmp", ".jpg", ".png", ".tga"}) {
@@ -46,59 +111,90 @@ std::optional<std::shared_ptr<Texture>> Texture::loadTexture(const std::string&
         std::cerr << "loadTexture: filename " << filename << " doesn't exists" << std::endl;
         return std::nullopt;
     }
-    auto insertion{allTexture.insert({name, std::make_shared<Texture>()})};
-    auto& target{insertion.first->second};
-    if (!insertion.second) {
-        // insert fail
-        if (target->filename == filename && target->available) {
-            return target;
-        } else {
-            target->clear();
-        }
+    MappedFile content(filename);
+    if (!content.valid()) {
+        std::cerr << "loadTexture: map " << filename << " fail" << std::endl;
+        return std::nullopt;
     }
+    const std::uint64_t hash{hashContent(content.data(), content.size())};
 
+    if (auto alias{allTexture.find(name)};
+        alias != allTexture.end() && alias->second->hash == hash && alias->second->available) {
+        return alias->second;
+    }
+    if (auto found{contentTexture.find(hash)};
+        found != contentTexture.end() && found->second->available) {
+        // same image already on GPU, only record the new name
+        allTexture.insert_or_assign(name, found->second);
+        uploadsAvoided++;
+        return found->second;
+    }
+
+    auto target{std::make_shared<Texture>()};
     target->name = name;
     target->filename = filename;
+    target->hash = hash;
 
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, channels;
-    unsigned char* data{stbi_load(filename.c_str(), &width, &height, &channels, 0)};
-    if (!data) {
-        std::cerr << "loadTexture: stb_load " << filename << "fail" << std::endl;
-        return std::nullopt;
+    GLint maxSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    if (auto probe{probeMappedImage(content)};
+        probe && std::max(probe->width, probe->height) > std::min(virtualThreshold, maxSize)) {
+        // tile once next to the source, later runs stream pages from the tiled file
+        const std::string tiled{filename + ".vtex"};
+        if (!std::filesystem::exists(tiled) ||
+            std::filesystem::last_write_time(tiled) < std::filesystem::last_write_time(filename)) {
+            std::cout << "loadTexture: tiling " << filename << " into " << tiled << std::endl;
+            if (!VirtualTexture::buildTiledFile(content, tiled)) return std::nullopt;
+        }
+        target->virt = std::make_shared<VirtualTexture>(tiled);
+        if (!target->virt->valid()) return std::nullopt;
+        target->width = probe->width;
+        target->height = probe->height;
+        target->available = true;
+        contentTexture.insert_or_assign(hash, target);
+        allTexture.insert_or_assign(name, target);
+        return target;
     }
-    target->width = width;
-    target->height = height;
-
-    GLenum format{GL_RGBA};
-    if (channels == 1)
-        format = GL_R;
-    if (channels == 2)
-        format = GL_RG;
-    if (channels == 3)
-        format = GL_RGB;
+
     glGenTextures(1, &(target->tex));
     glBindTexture(GL_TEXTURE_2D, target->tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, format,
-                 target->width, target->height, 0, format, GL_UNSIGNED_BYTE, data);
+    auto image{uploadMappedImage(content, true)};
+    if (!image) {
+        std::cerr << "loadTexture: decode " << filename << " fail" << std::endl;
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDeleteTextures(1, &(target->tex));
+        return std::nullopt;
+    }
+    target->width = image->width;
+    target->height = image->height;
     glGenerateMipmap(GL_TEXTURE_2D);
     glBindTexture(GL_TEXTURE_2D, 0);
-    stbi_image_free(data);
 
     if (GLenum gl_error_code{GL_NO_ERROR}; (gl_error_code = glGetError()) != GL_NO_ERROR) {
         std::cerr << "ERROR in loadTexture: \n" << gluErrorString(gl_error_code) << std::endl;
         return std::nullopt;
     }
     target->available = true;
+    contentTexture.insert_or_assign(hash, target);
+    allTexture.insert_or_assign(name, target);
     return target;
 }
 
 bool Texture::unloadTexture(const std::string& name) {
-    return allTexture.erase(name) != 0;
+    auto alias{allTexture.find(name)};
+    if (alias == allTexture.end()) return false;
+    const std::uint64_t hash{alias->second->hash};
+    allTexture.erase(alias);
+    // drop the content entry once no name refers to it any more
+    for (const auto& i : allTexture) {
+        if (i.second->hash == hash) return true;
+    }
+    contentTexture.erase(hash);
+    return true;
 }
 
 std::optional<std::shared_ptr<Texture>> Texture::getTexture(const std::string& name) {
@@ -112,6 +208,8 @@ void Texture::clear() {
     available = false;
     name = ""s;
     filename = ""s;
+    hash = 0u;
+    virt.reset();
     glDeleteTextures(1, &tex);
     tex = 0;
 }
@@ -119,6 +217,9 @@ void Texture::clear() {
 bool Texture::bind(GLenum textureChannel) const {
     if (!available)
         return false;
+    if (virt)
+        return virt->bind(textureChannel);
+    VirtualTexture::unbind();
     glActiveTexture(GL_TEXTURE0 + textureChannel);
     glBindTexture(GL_TEXTURE_2D, tex);
     return true;
@@ -20,10 +20,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-#define STB_IMAGE_STATIC
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -33,6 +30,8 @@
 
 using namespace std::string_literals;
 
+class VirtualTexture;
+
 class Texture {
 private:
     bool available;
@@ -40,12 +39,23 @@ private:
     std::string filename;
     int width;
     int height;
+    std::uint64_t hash;
     GLuint tex;
+    // set instead of `tex` for images too large to be fully resident
+    std::shared_ptr<VirtualTexture> virt;
 
+    static std::uint64_t hashContent(const unsigned char* data, std::size_t size);
 
 public:
+    // textures are owned by their content hash; names are only aliases to them, so the same
+    // image referenced under different names (or paths) is decoded and uploaded once.
+    using HashTextureMap = std::map<std::uint64_t, std::shared_ptr<Texture>>;
     using NameTextureMap = std::map<std::string, std::shared_ptr<Texture>>;
+    static HashTextureMap contentTexture;
     static NameTextureMap allTexture;
+    static std::size_t uploadsAvoided;
+    // images with a side longer than this (or than GL_MAX_TEXTURE_SIZE) are virtual textures
+    static int virtualThreshold;
 
     Texture();
     Texture(const Texture&) = delete;
@@ -58,6 +68,10 @@ public:
     static bool unloadTexture(const std::string& name);
     static std::optional<std::shared_ptr<Texture>> getTexture(const std::string& name);
 
+    bool isVirtual() const {
+        return virt != nullptr;
+    }
+
     void clear();
     bool bind(GLenum textureChannel) const;
 };
\ No newline at end of file
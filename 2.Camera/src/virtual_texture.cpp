@@ -0,0 +1,474 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "virtual_texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static constexpr char VT_MAGIC[4]{'V', 'T', 'E', 'X'};
+static constexpr std::uint32_t VT_VERSION{1};
+
+static int levelExtent(int size, int level) {
+    return std::max(1, size >> level);
+}
+
+static int tileCount(int size, int level, int tileSize) {
+    return (levelExtent(size, level) + tileSize - 1) / tileSize;
+}
+
+static int nextPowerOfTwo(int n) {
+    int p{1};
+    while (p < n) p <<= 1;
+    return p;
+}
+
+std::map<int, VirtualTexture*> VirtualTexture::allVirtual{};
+int VirtualTexture::nextId{1};
+std::uint64_t VirtualTexture::frame{0};
+
+bool VirtualTexture::buildTiledFile(const MappedFile& source, const std::string& tiledFilename,
+                                    int tileSize, int border) {
+    MappedPixels pixels(source);
+    if (!pixels.valid()) {
+        std::cerr << "buildTiledFile: cannot decode source of " << tiledFilename << std::endl;
+        return false;
+    }
+    const int width{pixels.info().width};
+    const int height{pixels.info().height};
+    const int pages{nextPowerOfTwo(
+        std::max(tileCount(width, 0, tileSize), tileCount(height, 0, tileSize)))};
+    int levels{1};
+    while ((1 << (levels - 1)) < pages) levels++;
+
+    std::ofstream out(tiledFilename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "buildTiledFile: cannot write " << tiledFilename << std::endl;
+        return false;
+    }
+    Header header{};
+    std::memcpy(header.magic, VT_MAGIC, sizeof(VT_MAGIC));
+    header.version = VT_VERSION;
+    header.width = width;
+    header.height = height;
+    header.tileSize = tileSize;
+    header.border = border;
+    header.levels = levels;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // only the level being tiled and the one it is filtered from are kept in memory; level 0 is
+    // read in place from the source
+    const int padded{tileSize + 2 * border};
+    std::vector<unsigned char> previous, current, tile(static_cast<std::size_t>(padded) * padded * 4);
+    for (int level = 0; level < levels; level++) {
+        const int w{levelExtent(width, level)};
+        const int h{levelExtent(height, level)};
+        if (level > 0) {
+            // 2x2 box filter of the previous level
+            const int pw{levelExtent(width, level - 1)};
+            const int ph{levelExtent(height, level - 1)};
+            const auto prevTexel{[&](int x, int y, unsigned char* rgba) {
+                x = std::min(x, pw - 1), y = std::min(y, ph - 1);
+                if (level == 1)
+                    pixels.texel(x, y, rgba);
+                else
+                    std::memcpy(rgba, &previous[(static_cast<std::size_t>(y) * pw + x) * 4], 4);
+            }};
+            current.assign(static_cast<std::size_t>(w) * h * 4, 0);
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                    unsigned sum[4]{};
+                    for (int dy = 0; dy < 2; dy++) {
+                        for (int dx = 0; dx < 2; dx++) {
+                            unsigned char rgba[4];
+                            prevTexel(2 * x + dx, 2 * y + dy, rgba);
+                            for (int c = 0; c < 4; c++) sum[c] += rgba[c];
+                        }
+                    }
+                    for (int c = 0; c < 4; c++)
+                        current[(static_cast<std::size_t>(y) * w + x) * 4 + c] = (sum[c] + 2) / 4;
+                }
+            }
+            previous.swap(current);
+        }
+        // texel of this level, clamped to its edge so borders of outer tiles repeat the edge
+        const auto levelTexel{[&](int x, int y, unsigned char* rgba) {
+            x = std::clamp(x, 0, w - 1), y = std::clamp(y, 0, h - 1);
+            if (level == 0)
+                pixels.texel(x, y, rgba);
+            else
+                std::memcpy(rgba, &previous[(static_cast<std::size_t>(y) * w + x) * 4], 4);
+        }};
+        const int tx{tileCount(width, level, tileSize)};
+        const int ty{tileCount(height, level, tileSize)};
+        for (int j = 0; j < ty; j++) {
+            for (int i = 0; i < tx; i++) {
+                for (int y = 0; y < padded; y++) {
+                    for (int x = 0; x < padded; x++) {
+                        levelTexel(i * tileSize + x - border, j * tileSize + y - border,
+                                   &tile[(static_cast<std::size_t>(y) * padded + x) * 4]);
+                    }
+                }
+                out.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+            }
+        }
+    }
+    return out.good();
+}
+
+VirtualTexture::VirtualTexture(const std::string& tiledFilename, int cachePages)
+    : available{false},
+      id{0},
+      file(tiledFilename),
+      header{},
+      paddedSize{0},
+      cachePages{cachePages},
+      indirectionSize{0},
+      cacheTex{0},
+      indirectionTex{0},
+      indirectionDirty{false} {
+    if (!file.valid() || file.size() < sizeof(Header)) {
+        std::cerr << "VirtualTexture: cannot map " << tiledFilename << std::endl;
+        return;
+    }
+    std::memcpy(&header, file.data(), sizeof(Header));
+    if (std::memcmp(header.magic, VT_MAGIC, sizeof(VT_MAGIC)) != 0 ||
+        header.version != VT_VERSION || header.tileSize == 0 || header.levels == 0) {
+        std::cerr << "VirtualTexture: " << tiledFilename << " is not a tiled texture" << std::endl;
+        return;
+    }
+    paddedSize = header.tileSize + 2 * header.border;
+    const std::size_t tileBytes{static_cast<std::size_t>(paddedSize) * paddedSize * 4};
+    std::size_t offset{0};
+    for (int level = 0; level < static_cast<int>(header.levels); level++) {
+        levelOffset.push_back(offset);
+        offset += tileBytes * tilesX(level) * tilesY(level);
+    }
+    if (sizeof(Header) + offset > file.size()) {
+        std::cerr << "VirtualTexture: " << tiledFilename << " is truncated" << std::endl;
+        return;
+    }
+    indirectionSize = 1 << (header.levels - 1);
+
+    const int cacheSize{cachePages * paddedSize};
+    glGenTextures(1, &cacheTex);
+    glBindTexture(GL_TEXTURE_2D, cacheTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSize, cacheSize, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    glGenTextures(1, &indirectionTex);
+    glBindTexture(GL_TEXTURE_2D, indirectionTex);
+    for (int level = 0; level < static_cast<int>(header.levels); level++) {
+        const int size{indirectionSize >> level};
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    slots.assign(static_cast<std::size_t>(cachePages) * cachePages, Slot{0, 0, false, false});
+    // the single coarsest page is always there to fall back on
+    if (!makeResident(pageKey(header.levels - 1, 0, 0), true)) return;
+    updateIndirection();
+
+    id = nextId++;
+    allVirtual[id] = this;
+    available = true;
+}
+
+VirtualTexture::~VirtualTexture() {
+    if (id) allVirtual.erase(id);
+    glDeleteTextures(1, &cacheTex);
+    glDeleteTextures(1, &indirectionTex);
+}
+
+int VirtualTexture::tilesX(int level) const {
+    return tileCount(header.width, level, header.tileSize);
+}
+
+int VirtualTexture::tilesY(int level) const {
+    return tileCount(header.height, level, header.tileSize);
+}
+
+std::size_t VirtualTexture::residentBytes() const {
+    std::size_t bytes{static_cast<std::size_t>(cachePages) * paddedSize * cachePages *
+                      paddedSize * 4};
+    for (int level = 0; level < static_cast<int>(header.levels); level++) {
+        const std::size_t size{static_cast<std::size_t>(indirectionSize >> level)};
+        bytes += size * size * 4;
+    }
+    return bytes;
+}
+
+const unsigned char* VirtualTexture::tileData(int level, int x, int y) const {
+    const std::size_t tileBytes{static_cast<std::size_t>(paddedSize) * paddedSize * 4};
+    return file.data() + sizeof(Header) + levelOffset[level] +
+           (static_cast<std::size_t>(y) * tilesX(level) + x) * tileBytes;
+}
+
+bool VirtualTexture::makeResident(std::uint64_t key, bool pinned) {
+    if (auto found{pageSlot.find(key)}; found != pageSlot.end()) {
+        slots[found->second].lastUsed = frame;
+        return true;
+    }
+    // free slot first, otherwise the least recently used page not needed by this frame
+    int victim{-1};
+    for (int i = 0; i < static_cast<int>(slots.size()); i++) {
+        const Slot& slot{slots[i]};
+        if (!slot.occupied) {
+            victim = i;
+            break;
+        }
+        if (slot.pinned || slot.lastUsed >= frame) continue;
+        if (victim < 0 || slot.lastUsed < slots[victim].lastUsed) victim = i;
+    }
+    if (victim < 0) return false;
+    if (slots[victim].occupied) pageSlot.erase(slots[victim].page);
+
+    const int level{static_cast<int>(key >> 48)};
+    const int y{static_cast<int>((key >> 24) & 0xFFFFFF)};
+    const int x{static_cast<int>(key & 0xFFFFFF)};
+    glBindTexture(GL_TEXTURE_2D, cacheTex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (victim % cachePages) * paddedSize,
+                    (victim / cachePages) * paddedSize, paddedSize, paddedSize, GL_RGBA,
+                    GL_UNSIGNED_BYTE, tileData(level, x, y));
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    slots[victim] = Slot{key, frame, true, pinned};
+    pageSlot[key] = victim;
+    indirectionDirty = true;
+    return true;
+}
+
+void VirtualTexture::update() {
+    if (requests.empty()) return;
+    // every requested page pulls in its ancestors, so a fallback is always close
+    std::map<std::uint64_t, unsigned> wanted;
+    for (const auto& [key, count] : requests) {
+        int level{static_cast<int>(key >> 48)};
+        int y{static_cast<int>((key >> 24) & 0xFFFFFF)};
+        int x{static_cast<int>(key & 0xFFFFFF)};
+        if (level >= static_cast<int>(header.levels) || x >= tilesX(level) || y >= tilesY(level))
+            continue;
+        for (; level < static_cast<int>(header.levels); level++, x /= 2, y /= 2)
+            wanted[pageKey(level, x, y)] += count;
+    }
+    requests.clear();
+
+    // coarse levels first, then the pages covering most pixels
+    std::vector<std::pair<std::uint64_t, unsigned>> order(wanted.begin(), wanted.end());
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+        if ((a.first >> 48) != (b.first >> 48)) return (a.first >> 48) > (b.first >> 48);
+        return a.second > b.second;
+    });
+    // every wanted page that is resident is marked used before any upload can evict it
+    for (const auto& i : order) {
+        if (auto found{pageSlot.find(i.first)}; found != pageSlot.end())
+            slots[found->second].lastUsed = frame;
+    }
+    int uploads{0};
+    for (const auto& i : order) {
+        if (uploads >= uploadsPerFrame) break;
+        if (!pageSlot.contains(i.first) && makeResident(i.first, false)) uploads++;
+    }
+    if (indirectionDirty) updateIndirection();
+}
+
+void VirtualTexture::updateIndirection() {
+    // coarse to fine: a page that is not resident inherits the entry of its parent
+    std::vector<std::uint32_t> parent, entries;
+    glBindTexture(GL_TEXTURE_2D, indirectionTex);
+    for (int level = header.levels - 1; level >= 0; level--) {
+        const int size{indirectionSize >> level};
+        entries.assign(static_cast<std::size_t>(size) * size, 0);
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                std::uint32_t entry{0};
+                auto found{x < tilesX(level) && y < tilesY(level)
+                               ? pageSlot.find(pageKey(level, x, y))
+                               : pageSlot.end()};
+                if (found != pageSlot.end()) {
+                    const std::uint32_t slotX = found->second % cachePages;
+                    const std::uint32_t slotY = found->second / cachePages;
+                    entry = slotX | slotY << 8 | static_cast<std::uint32_t>(level) << 16 |
+                            0xFFu << 24;
+                } else if (!parent.empty()) {
+                    entry = parent[static_cast<std::size_t>(y / 2) * (size / 2) + x / 2];
+                }
+                entries[static_cast<std::size_t>(y) * size + x] = entry;
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE,
+                        entries.data());
+        parent.swap(entries);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    indirectionDirty = false;
+}
+
+bool VirtualTexture::bind(GLenum channel) const {
+    if (!available) return false;
+    glActiveTexture(GL_TEXTURE0 + SCENE_RESOURCE_SHADER_VT_INDIRECTION_CHANNEL);
+    glBindTexture(GL_TEXTURE_2D, indirectionTex);
+    glActiveTexture(GL_TEXTURE0 + channel);
+    glBindTexture(GL_TEXTURE_2D, cacheTex);
+
+    GLint program;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    const float cacheSize = cachePages * paddedSize;
+    glUniform1i(glGetUniformLocation(program, "u_vt_enabled"), 1);
+    glUniform1i(glGetUniformLocation(program, "u_vt_id"), id);
+    glUniform1i(glGetUniformLocation(program, "u_vt_indirection"),
+                SCENE_RESOURCE_SHADER_VT_INDIRECTION_CHANNEL);
+    glUniform2i(glGetUniformLocation(program, "u_vt_size"), header.width, header.height);
+    glUniform4f(glGetUniformLocation(program, "u_vt_page"), header.tileSize, header.border,
+                cacheSize, cacheSize);
+    glUniform1i(glGetUniformLocation(program, "u_vt_max_level"), header.levels - 1);
+    return true;
+}
+
+void VirtualTexture::unbind() {
+    GLint program;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    if (program) glUniform1i(glGetUniformLocation(program, "u_vt_enabled"), 0);
+}
+
+VirtualTexture::Feedback::Feedback(int divisor)
+    : divisor{divisor},
+      width{0},
+      height{0},
+      fbo{0},
+      color{0},
+      depth{0},
+      pbo{},
+      fence{},
+      writeIndex{0},
+      previousViewport{} {
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glGenBuffers(ringSize, pbo.data());
+}
+
+VirtualTexture::Feedback::~Feedback() {
+    for (auto& i : fence) {
+        if (i) glDeleteSync(i);
+    }
+    glDeleteBuffers(ringSize, pbo.data());
+    glDeleteRenderbuffers(1, &depth);
+    glDeleteTextures(1, &color);
+    glDeleteFramebuffers(1, &fbo);
+}
+
+void VirtualTexture::Feedback::resize(int w, int h) {
+    width = w;
+    height = h;
+    glBindTexture(GL_TEXTURE_2D, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, w, h, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT,
+                 nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // pending read backs have the old size, drop them
+    for (int i = 0; i < ringSize; i++) {
+        if (fence[i]) glDeleteSync(fence[i]);
+        fence[i] = nullptr;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(w) * h * 4 * sizeof(GLushort),
+                     nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTexture::Feedback::begin(GLuint program, int screenWidth, int screenHeight) {
+    const int w{std::max(1, screenWidth / divisor)};
+    const int h{std::max(1, screenHeight / divisor)};
+    if (w != width || h != height) resize(w, h);
+
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    const GLuint empty[4]{0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, empty);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glUseProgram(program);
+    // derivatives are `divisor` times larger than on screen
+    glUniform1f(glGetUniformLocation(program, "u_vt_lod_bias"), -std::log2(float(divisor)));
+}
+
+void VirtualTexture::Feedback::end() {
+    if (fence[writeIndex]) glDeleteSync(fence[writeIndex]);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[writeIndex]);
+    glReadPixels(0, 0, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fence[writeIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    writeIndex = (writeIndex + 1) % ringSize;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2],
+               previousViewport[3]);
+}
+
+bool VirtualTexture::Feedback::process() {
+    frame++;
+    bool any{false};
+    // oldest first; a fence that has not signalled yet is simply left for a later frame
+    for (int n = 0; n < ringSize; n++) {
+        const int i{(writeIndex + n) % ringSize};
+        if (!fence[i]) continue;
+        const GLenum status{glClientWaitSync(fence[i], 0, 0)};
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+        glDeleteSync(fence[i]);
+        fence[i] = nullptr;
+
+        const std::size_t texels{static_cast<std::size_t>(width) * height};
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[i]);
+        auto data{static_cast<const GLushort*>(glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, texels * 4 * sizeof(GLushort), GL_MAP_READ_BIT))};
+        if (data) {
+            for (std::size_t t = 0; t < texels; t++) {
+                const GLushort* texel{data + t * 4};
+                if (!texel[3]) continue;
+                if (auto vt{allVirtual.find(texel[3])}; vt != allVirtual.end())
+                    vt->second->requests[pageKey(texel[2], texel[0], texel[1])]++;
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            any = true;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    for (auto& i : allVirtual) i.second->update();
+    return any;
+}
@@ -0,0 +1,166 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+// Software virtual texturing: the image lives in a tiled file on disk, only the pages that a
+// low-resolution feedback pass asks for are kept in a fixed-size page cache texture, and an
+// indirection texture maps every virtual page to its cache slot (or to the nearest resident
+// coarser page). Works on plain GL 3.3, no sparse texture extension is used.
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_image.h"
+
+#define SCENE_RESOURCE_SHADER_VT_INDIRECTION_CHANNEL 1
+
+// The GLSL side lives in shaders/virtual_texture.glsl (vtSample() and the u_vt_* uniforms) and
+// shaders/vt_feedback.frag (the fragment stage of the feedback pass).
+
+class VirtualTexture {
+public:
+    static constexpr int defaultTileSize{128};
+    static constexpr int defaultBorder{4};
+    static constexpr int defaultCachePages{16};
+    // pages streamed into the cache per processed feedback frame
+    static constexpr int uploadsPerFrame{16};
+
+    // Writes `tiledFilename` from a source image: every mip level split into tiles of
+    // `tileSize` texels plus a `border` of neighbouring texels on each side, RGBA8.
+    static bool buildTiledFile(const MappedFile& source, const std::string& tiledFilename,
+                               int tileSize = defaultTileSize, int border = defaultBorder);
+
+    // `cachePages` x `cachePages` pages are resident at most, whatever the virtual size is.
+    explicit VirtualTexture(const std::string& tiledFilename, int cachePages = defaultCachePages);
+    VirtualTexture(const VirtualTexture&) = delete;
+    ~VirtualTexture();
+
+    bool valid() const {
+        return available;
+    }
+    int width() const {
+        return header.width;
+    }
+    int height() const {
+        return header.height;
+    }
+    std::size_t residentPages() const {
+        return pageSlot.size();
+    }
+    std::size_t cacheCapacity() const {
+        return slots.size();
+    }
+    std::size_t residentBytes() const;
+
+    // binds the page cache on `channel` and the indirection table on
+    // SCENE_RESOURCE_SHADER_VT_INDIRECTION_CHANNEL, and sets the u_vt_* uniforms of the current
+    // program.
+    bool bind(GLenum channel) const;
+    // marks the current program as sampling an ordinary texture
+    static void unbind();
+    // whether any virtual texture is loaded, and so whether feedback is worth rendering
+    static bool anyLoaded() {
+        return !allVirtual.empty();
+    }
+
+    // Low-resolution render target whose content is read back a few frames later through a
+    // ring of pixel pack buffers, so the CPU never waits for the GPU.
+    class Feedback {
+    private:
+        static constexpr int ringSize{3};
+        int divisor;
+        int width;
+        int height;
+        GLuint fbo;
+        GLuint color;
+        GLuint depth;
+        std::array<GLuint, ringSize> pbo;
+        std::array<GLsync, ringSize> fence;
+        int writeIndex;
+        GLint previousViewport[4];
+
+        void resize(int w, int h);
+
+    public:
+        explicit Feedback(int divisor = 8);
+        Feedback(const Feedback&) = delete;
+        ~Feedback();
+
+        // starts rendering the feedback of a `screenWidth` x `screenHeight` frame with `program`
+        void begin(GLuint program, int screenWidth, int screenHeight);
+        // queues the asynchronous read back of what was rendered since begin()
+        void end();
+        // hands every finished read back to the virtual textures, returns false if none was ready
+        bool process();
+    };
+
+private:
+    struct Header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t tileSize;
+        std::uint32_t border;
+        std::uint32_t levels;
+        std::uint32_t reserved;
+    };
+    struct Slot {
+        std::uint64_t page;
+        std::uint64_t lastUsed;
+        bool occupied;
+        bool pinned;
+    };
+
+    static std::map<int, VirtualTexture*> allVirtual;
+    static int nextId;
+    static std::uint64_t frame;
+
+    bool available;
+    int id;
+    MappedFile file;
+    Header header;
+    int paddedSize;
+    int cachePages;
+    int indirectionSize;
+    std::vector<std::size_t> levelOffset;
+    GLuint cacheTex;
+    GLuint indirectionTex;
+    std::vector<Slot> slots;
+    std::map<std::uint64_t, int> pageSlot;
+    std::map<std::uint64_t, unsigned> requests;
+    bool indirectionDirty;
+
+    static std::uint64_t pageKey(int level, int x, int y) {
+        return static_cast<std::uint64_t>(level) << 48 | static_cast<std::uint64_t>(y) << 24 |
+               static_cast<std::uint64_t>(x);
+    }
+    int tilesX(int level) const;
+    int tilesY(int level) const;
+    const unsigned char* tileData(int level, int x, int y) const;
+
+    bool makeResident(std::uint64_t key, bool pinned);
+    void update();
+    void updateIndirection();
+};
@@ -0,0 +1,226 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Camera.
+//
+// CGHomework/Camera is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Camera is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Camera.  If not, see <http://www.gnu.org/licenses/>.
+
+// Build step that turns GLSL files into a C++ lookup table:
+//
+//     embed_shaders [--validator glslangValidator] <output.cpp> <shader>...
+//
+// `#include "file"` is resolved relative to the including file (each file at most once per
+// shader), comments are stripped, and the result is checked before it is written out as
+// `const char* embeddedShader(std::string_view name)`. Any error fails the build.
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Error {
+    std::string message;
+};
+
+std::string readFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw Error{path.string() + ": cannot open"};
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return stream.str();
+}
+
+// removes // and /* */ comments; a block comment keeps its line breaks so that the code
+// around it stays on separate lines, empty lines are dropped later by compact()
+std::string stripComments(const std::string& source) {
+    std::string result;
+    result.reserve(source.size());
+    for (std::size_t i{0}; i < source.size(); i++) {
+        if (source.compare(i, 2, "//") == 0) {
+            while (i < source.size() && source[i] != '\n') i++;
+            if (i < source.size()) result += '\n';
+        } else if (source.compare(i, 2, "/*") == 0) {
+            auto end{source.find("*/", i + 2)};
+            if (end == std::string::npos) end = source.size();
+            for (auto j{i}; j < end; j++)
+                if (source[j] == '\n') result += '\n';
+            i = end + 1;
+        } else if (source[i] != '\r') {
+            result += source[i];
+        }
+    }
+    return result;
+}
+
+// trailing spaces and empty lines carry no information; line numbers in driver messages refer
+// to the embedded text anyway, which no longer matches the files once includes are in
+std::string compact(const std::string& source) {
+    static const std::regex trailing{"[ \t]+\n"};
+    static const std::regex empty{"\n\n+"};
+    auto result{std::regex_replace(std::regex_replace(source, trailing, "\n"), empty, "\n")};
+    if (!result.empty() && result.front() == '\n') result.erase(0, 1);
+    return result;
+}
+
+std::string preprocess(const fs::path& path, std::set<fs::path>& included,
+                       std::vector<fs::path>& stack) {
+    auto canonical{fs::weakly_canonical(path)};
+    for (auto& open : stack)
+        if (open == canonical) throw Error{path.string() + ": recursive #include"};
+    if (!included.insert(canonical).second) return {};
+    stack.push_back(canonical);
+
+    static const std::regex include{R"re(^\s*#\s*include\s+"([^"]+)"\s*$)re"};
+    std::istringstream lines(stripComments(readFile(path)));
+    std::string result;
+    std::string line;
+    for (auto number{1}; std::getline(lines, line); number++) {
+        if (std::smatch match; std::regex_match(line, match, include)) {
+            auto target{path.parent_path() / match[1].str()};
+            if (!fs::exists(target))
+                throw Error{path.string() + ":" + std::to_string(number) + ": " +
+                            match[1].str() + " not found"};
+            result += preprocess(target, included, stack);
+        } else {
+            result += line;
+            result += '\n';
+        }
+    }
+    stack.pop_back();
+    return result;
+}
+
+void validate(const std::string& name, const std::string& source) {
+    std::istringstream lines(source);
+    std::string line;
+    auto number{0};
+    auto sawCode{false};
+    auto versions{0};
+    while (std::getline(lines, line)) {
+        number++;
+        if (line.find_first_not_of(" \t") == std::string::npos) continue;
+        if (line.find("#version") != std::string::npos) {
+            if (sawCode) throw Error{name + ":" + std::to_string(number) + ": #version not first"};
+            versions++;
+        }
+        sawCode = true;
+    }
+    if (versions != 1) throw Error{name + ": expected exactly one #version directive"};
+
+    int parens{0}, braces{0};
+    for (auto c : source) {
+        parens += c == '(' ? 1 : c == ')' ? -1 : 0;
+        braces += c == '{' ? 1 : c == '}' ? -1 : 0;
+        if (parens < 0 || braces < 0) break;
+    }
+    if (parens != 0 || braces != 0) throw Error{name + ": unbalanced parentheses or braces"};
+}
+
+// glslangValidator cannot tell the stage from names like vert.glsl
+const char* stageOf(const std::string& name) {
+    if (name.find("vert") != std::string::npos) return "vert";
+    if (name.find("frag") != std::string::npos) return "frag";
+    if (name.find("geom") != std::string::npos) return "geom";
+    return nullptr;
+}
+
+void runValidator(const std::string& validator, const fs::path& output, const std::string& name,
+                  const std::string& source) {
+    auto stage{stageOf(name)};
+    if (!stage) return;
+    auto temporary{output};
+    temporary += "." + name;
+    std::ofstream(temporary, std::ios::binary) << source;
+    auto command{"\"" + validator + "\" -S " + stage + " \"" + temporary.string() + "\""};
+    auto status{std::system(command.c_str())};
+    fs::remove(temporary);
+    if (status != 0) throw Error{name + ": rejected by " + validator};
+}
+
+std::string generate(const std::vector<std::pair<std::string, std::string>>& shaders) {
+    std::ostringstream out;
+    out << "// generated by embed_shaders, do not edit\n\n"
+        << "#include \"embedded_shaders.h\"\n\n"
+        << "#include <array>\n#include <utility>\n\n"
+        << "namespace {\n\n";
+    for (std::size_t i{0}; i < shaders.size(); i++) {
+        out << "// " << shaders[i].first << "\nconstexpr char shader" << i << "[]{";
+        auto column{0};
+        for (unsigned char c : shaders[i].second) {
+            if (column++ % 16 == 0) out << "\n   ";
+            out << ' ' << static_cast<int>(c) << ',';
+        }
+        out << "\n    0};\n\n";
+    }
+    out << "constexpr std::array<std::pair<std::string_view, const char*>, " << shaders.size()
+        << "> shaders{{\n";
+    for (std::size_t i{0}; i < shaders.size(); i++)
+        out << "    {\"" << shaders[i].first << "\", shader" << i << "},\n";
+    out << "}};\n\n}  // namespace\n\n"
+        << "const char* embeddedShader(std::string_view name) {\n"
+        << "    for (auto& [shaderName, source] : shaders)\n"
+        << "        if (shaderName == name) return source;\n"
+        << "    return nullptr;\n"
+        << "}\n";
+    return out.str();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string validator;
+    if (args.size() >= 2 && args[0] == "--validator") {
+        validator = args[1];
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    if (args.empty()) {
+        std::cerr << "usage: embed_shaders [--validator exe] <output.cpp> <shader>..." << std::endl;
+        return EXIT_FAILURE;
+    }
+    fs::path output{args[0]};
+
+    try {
+        std::vector<std::pair<std::string, std::string>> shaders;
+        std::set<std::string> names;
+        for (std::size_t i{1}; i < args.size(); i++) {
+            fs::path path{args[i]};
+            auto name{path.filename().string()};
+            if (!names.insert(name).second) throw Error{name + ": embedded twice"};
+            std::set<fs::path> included;
+            std::vector<fs::path> stack;
+            auto source{compact(preprocess(path, included, stack))};
+            validate(name, source);
+            if (!validator.empty()) runValidator(validator, output, name, source);
+            shaders.emplace_back(name, std::move(source));
+        }
+
+        std::ofstream file(output, std::ios::binary);
+        file << generate(shaders);
+        if (!file) throw Error{output.string() + ": cannot write"};
+    } catch (const Error& e) {
+        std::cerr << "embed_shaders: " << e.message << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
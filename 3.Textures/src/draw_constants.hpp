@@ -0,0 +1,70 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Textures.
+//
+// CGHomework/Textures is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Textures is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Textures.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DRAW_CONSTANTS_H
+#define DRAW_CONSTANTS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+// Per-draw transforms shared by every program through one std140 uniform block:
+//
+//     layout (std140) uniform DrawConstants {
+//         mat4 model;
+//         mat4 normalMatrix;  // upper 3x3 is transpose(inverse(mat3(model)))
+//         mat4 mvp;
+//     };
+//
+// The normal matrix and MVP are computed here once per draw instead of once per vertex.
+class DrawConstants {
+public:
+    static constexpr GLuint binding{0};
+    static constexpr const char* const blockName{"DrawConstants"};
+
+    // fills the block for the next draw calls
+    static void set(const glm::mat4& model, const glm::mat4& viewProjection) {
+        Block block{model, glm::mat4(glm::transpose(glm::inverse(glm::mat3(model)))),
+                    viewProjection * model};
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer());
+        // orphaned each time, so a draw still reading the previous values never stalls us
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(block), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    }
+
+private:
+    struct Block {
+        glm::mat4 model;
+        glm::mat4 normalMatrix;
+        glm::mat4 mvp;
+    };
+    static_assert(sizeof(Block) == 3 * 16 * sizeof(float));
+
+    static GLuint buffer() {
+        static const GLuint ubo{[] {
+            GLuint ubo;
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_STREAM_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+            return ubo;
+        }()};
+        return ubo;
+    }
+};
+
+#endif
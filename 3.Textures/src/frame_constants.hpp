@@ -0,0 +1,102 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Textures.
+//
+// CGHomework/Textures is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Textures is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Textures.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAME_CONSTANTS_H
+#define FRAME_CONSTANTS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstring>
+
+// Camera and light values shared by every program through one std140 uniform block, written
+// once per frame:
+//
+//     layout (std140) uniform FrameConstants {
+//         mat4 projection;
+//         mat4 view;
+//         vec4 viewPos;   // xyz
+//         vec4 lightPos;  // xyz
+//     };
+//
+// The buffer is a ring of three slots; a slot is only rewritten once the fence of the frame that
+// read it has passed, so writing never waits for the GPU in practice.
+class FrameConstants {
+public:
+    static constexpr GLuint binding{1};
+    static constexpr const char* const blockName{"FrameConstants"};
+
+    struct Block {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec4 viewPos;
+        glm::vec4 lightPos;
+    };
+    static_assert(sizeof(Block) == (2 * 16 + 2 * 4) * sizeof(float));
+
+    // writes this frame's values into the next slot and binds it
+    static void update(const Block& block) {
+        auto& ring{instance()};
+        // everything issued since the last update read the current slot
+        ring.fence[ring.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ring.slot = (ring.slot + 1) % ringSize;
+        if (auto& fence{ring.fence[ring.slot]}) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        auto offset{static_cast<GLintptr>(ring.slot * ring.stride)};
+        glBindBuffer(GL_UNIFORM_BUFFER, ring.ubo);
+        if (auto data{glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(Block),
+                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                           GL_MAP_UNSYNCHRONIZED_BIT)}) {
+            std::memcpy(data, &block, sizeof(Block));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.ubo, offset, sizeof(Block));
+    }
+
+private:
+    static constexpr int ringSize{3};
+
+    struct Ring {
+        GLuint ubo;
+        GLsizeiptr stride;
+        int slot{0};
+        std::array<GLsync, ringSize> fence{};
+
+        Ring() {
+            // bound ranges have to start at a multiple of the offset alignment
+            GLint alignment{256};
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            stride = (sizeof(Block) + alignment - 1) / alignment * alignment;
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, ringSize * stride, nullptr, GL_DYNAMIC_DRAW);
+        }
+    };
+
+    static Ring& instance() {
+        static Ring ring;
+        return ring;
+    }
+};
+
+#endif
@@ -0,0 +1,23 @@
+// Copyright (C) 2021 Guyutongxue
+// 
+// This file is part of CGHomework/Textures.
+// 
+// CGHomework/Textures is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// CGHomework/Textures is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Textures.  If not, see <http://www.gnu.org/licenses/>.
+
+#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 MVP;
+void main() {
+    gl_Position = MVP * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+}
@@ -17,8 +17,6 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -29,6 +27,9 @@
 #include "camera.h"
 #include "shader.h"
 #include "light.hpp"
+#include "draw_constants.hpp"
+#include "frame_constants.hpp"
+#include "mapped_image.h"
 
 #include <imgui.h>
 #include "imgui/imgui_impl_glfw.h"
@@ -107,6 +108,8 @@ int main() {
     glCullFace(GL_BACK);
 
     // build and compile shaders
+    ProgramCache::bindUniformBlock(DrawConstants::blockName, DrawConstants::binding);
+    ProgramCache::bindUniformBlock(FrameConstants::blockName, FrameConstants::binding);
     Shader shader("vert.glsl", "frag.glsl");
 
     // load textures
@@ -151,17 +154,15 @@ int main() {
         glm::mat4 projection = glm::perspective(
             glm::radians(camera.zoom), static_cast<float>(SCR_WIDTH / SCR_HEIGHT), 0.1f, 100.0f);
         glm::mat4 view = camera.getViewMatrix();
+        FrameConstants::update(
+            {projection, view, glm::vec4(camera.position, 1.0f), glm::vec4(lightPos, 1.0f)});
         shader.use();
-        shader.setUniform("projection", projection);
-        shader.setUniform("view", view);
         // render normal-mapped quad
         glm::mat4 model = glm::mat4(1.0f);
         // rotate the quad to show normal mapping from multiple directions
         model = glm::rotate(model, glm::radians<float>(glfwGetTime() * -10.0f),
                             glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-        shader.setUniform("model", model);
-        shader.setUniform("viewPos", camera.position);
-        shader.setUniform("lightPos", lightPos);
+        DrawConstants::set(model, projection * view);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, diffuseMap);
         glActiveTexture(GL_TEXTURE1);
@@ -352,20 +353,11 @@ static void error_callback(int error, const char* description) {
 unsigned int loadTexture(const char* path) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    MappedFile file(path);
+    if (auto image{uploadMappedImage(file, false)}) {
+        GLenum format{image->channels == 4 ? GLenum{GL_RGBA} : GLenum{GL_RGB}};
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
@@ -375,11 +367,8 @@ unsigned int loadTexture(const char* path) {
                         format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     } else {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
 
     return textureID;
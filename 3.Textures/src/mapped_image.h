@@ -0,0 +1,65 @@
+// Copyright (C) 2021 Guyutongxue
+//
+// This file is part of CGHomework/Textures.
+//
+// CGHomework/Textures is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// CGHomework/Textures is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with CGHomework/Textures.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+    const unsigned char* view;
+    std::size_t length;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#else
+    int fd;
+#endif
+
+public:
+    explicit MappedFile(const std::string& filename);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool valid() const {
+        return view != nullptr;
+    }
+    const unsigned char* data() const {
+        return view;
+    }
+    std::size_t size() const {
+        return length;
+    }
+};
+
+struct ImageInfo {
+    int width;
+    int height;
+    int channels;
+};
+
+// Decodes the mapped image into level 0 of the texture currently bound to GL_TEXTURE_2D.
+// Uncompressed BMP/TGA rows are copied straight from the mapping into a mapped pixel unpack
+// buffer; other formats go through stbi_load_from_memory. With `flip` set the last image row
+// becomes the first texture row, as OpenGL texture coordinates expect.
+std::optional<ImageInfo> uploadMappedImage(const MappedFile& file, bool flip);
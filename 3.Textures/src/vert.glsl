@@ -30,27 +30,32 @@ out VS_OUT {
     vec3 TangentFragPos;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+layout (std140) uniform DrawConstants {
+    mat4 model;
+    mat4 normalMatrix;
+    mat4 mvp;
+};
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+layout (std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+};
 
 void main() {
     vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
     vs_out.TexCoords = aTexCoords;
     
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
-    vec3 T = normalize(normalMatrix * aTangent);
-    vec3 N = normalize(normalMatrix * aNormal);
+    vec3 T = normalize(mat3(normalMatrix) * aTangent);
+    vec3 N = normalize(mat3(normalMatrix) * aNormal);
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
     
     mat3 TBN = transpose(mat3(T, B, N));    
-    vs_out.TangentLightPos = TBN * lightPos;
-    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentLightPos = TBN * lightPos.xyz;
+    vs_out.TangentViewPos  = TBN * viewPos.xyz;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
         
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 }
\ No newline at end of file
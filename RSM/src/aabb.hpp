@@ -0,0 +1,41 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef AABB_H
+#define AABB_H
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+// Axis aligned bounding box; empty (low above high) until something is added.
+struct Aabb {
+    glm::vec3 low{std::numeric_limits<float>::max()};
+    glm::vec3 high{std::numeric_limits<float>::lowest()};
+
+    void add(const glm::vec3& point) {
+        low = glm::min(low, point);
+        high = glm::max(high, point);
+    }
+
+    glm::vec3 center() const {
+        return (low + high) * 0.5f;
+    }
+    glm::vec3 extent() const {
+        return (high - low) * 0.5f;
+    }
+
+    // the box around this one after `transform` (Arvo): the center moves, the extent goes
+    // through the absolute value of the linear part
+    Aabb transformed(const glm::mat4& transform) const {
+        auto newCenter{glm::vec3(transform * glm::vec4(center(), 1.0f))};
+        auto linear{glm::mat3(transform)};
+        for (int i{0}; i < 3; i++) linear[i] = glm::abs(linear[i]);
+        auto newExtent{linear * extent()};
+        return {newCenter - newExtent, newCenter + newExtent};
+    }
+};
+
+#endif
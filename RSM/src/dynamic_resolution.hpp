@@ -0,0 +1,75 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <cstddef>
+#include <vector>
+
+// Picks one of `levelCount` quality levels, 0 the best and each next one cheaper, so that the
+// measured frame time holds a target. What a level means is up to the caller.
+//
+// Hysteresis: the average has to stay over the target for a while before dropping a level, and
+// well under it for longer before raising one. Each level also remembers the time it was last
+// measured at; raising is only tried when that memory fits the target, and the memory fades
+// slowly so a scene that got cheaper is retried eventually. After every change the controller
+// waits for the average to settle.
+class DynamicResolution {
+public:
+    float targetMs;
+
+    DynamicResolution(std::size_t levelCount, float targetMs)
+        : targetMs{targetMs}, level{0}, averageMs{0.0f}, frames{0}, over{0}, under{0},
+          levelMs(levelCount, 0.0f) {}
+
+    std::size_t getLevel() const {
+        return level;
+    }
+    float getAverageMs() const {
+        return averageMs;
+    }
+
+    // starts over from `newLevel`, e.g. after the settings were changed by hand
+    void reset(std::size_t newLevel) {
+        level = newLevel;
+        frames = over = under = 0;
+    }
+
+    // feeds the time of one frame; true when the level changed
+    bool update(float frameMs) {
+        averageMs = frames == 0 ? frameMs : averageMs + (frameMs - averageMs) * 0.1f;
+        if (++frames < SETTLE_FRAMES) return false;
+        levelMs[level] = averageMs;
+        for (auto& ms : levelMs) ms *= 0.999f;
+
+        over = averageMs > targetMs ? over + 1 : 0;
+        under = averageMs < targetMs * 0.7f ? under + 1 : 0;
+        if (over >= DROP_FRAMES && level + 1 < levelMs.size()) {
+            reset(level + 1);
+            return true;
+        }
+        if (under >= RAISE_FRAMES && level > 0 && levelMs[level - 1] < targetMs) {
+            reset(level - 1);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // frames before the average counts, after a change
+    static constexpr unsigned SETTLE_FRAMES{20};
+    // frames in a row over the target (under 70% of it) that drop (raise) a level
+    static constexpr unsigned DROP_FRAMES{10};
+    static constexpr unsigned RAISE_FRAMES{60};
+
+    std::size_t level;
+    float averageMs;
+    unsigned frames, over, under;
+    // average time last measured at each level
+    std::vector<float> levelMs;
+};
+
+#endif
@@ -0,0 +1,16 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+#include <string_view>
+
+// Source of the shader file `name` (e.g. "main_shader.frag") as it was at build time, with
+// #include resolved and comments stripped; nullptr if no such shader was embedded. The table
+// is generated by tools/embed_shaders.cpp, so no shader file is read at startup.
+const char* embeddedShader(std::string_view name);
+
+#endif
@@ -0,0 +1,90 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef FRAME_CONSTANTS_H
+#define FRAME_CONSTANTS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstring>
+
+// Camera values shared by every program through one std140 uniform block, written once per
+// frame (the lights are in LightList):
+//
+//     layout (std140) uniform FrameConstants {
+//         mat4 projection;
+//         mat4 view;
+//         mat4 inverseViewProjection;  // camera clip space back to world
+//         vec4 viewPos;  // xyz
+//     };
+//
+// The buffer is a ring of three slots; a slot is only rewritten once the fence of the frame that
+// read it has passed, so writing never waits for the GPU in practice.
+class FrameConstants {
+public:
+    static constexpr GLuint binding{1};
+    static constexpr const char* const blockName{"FrameConstants"};
+
+    struct Block {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::mat4 inverseViewProjection;
+        glm::vec4 viewPos;
+    };
+    static_assert(sizeof(Block) == (3 * 16 + 4) * sizeof(float));
+
+    // writes this frame's values into the next slot and binds it
+    static void update(const Block& block) {
+        auto& ring{instance()};
+        // everything issued since the last update read the current slot
+        ring.fence[ring.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ring.slot = (ring.slot + 1) % ringSize;
+        if (auto& fence{ring.fence[ring.slot]}) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        auto offset{static_cast<GLintptr>(ring.slot * ring.stride)};
+        glBindBuffer(GL_UNIFORM_BUFFER, ring.ubo);
+        if (auto data{glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(Block),
+                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                           GL_MAP_UNSYNCHRONIZED_BIT)}) {
+            std::memcpy(data, &block, sizeof(Block));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.ubo, offset, sizeof(Block));
+    }
+
+private:
+    static constexpr int ringSize{3};
+
+    struct Ring {
+        GLuint ubo;
+        GLsizeiptr stride;
+        int slot{0};
+        std::array<GLsync, ringSize> fence{};
+
+        Ring() {
+            // bound ranges have to start at a multiple of the offset alignment
+            GLint alignment{256};
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            stride = (sizeof(Block) + alignment - 1) / alignment * alignment;
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, ringSize * stride, nullptr, GL_DYNAMIC_DRAW);
+        }
+    };
+
+    static Ring& instance() {
+        static Ring ring;
+        return ring;
+    }
+};
+
+#endif
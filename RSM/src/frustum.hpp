@@ -0,0 +1,66 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include "aabb.hpp"
+
+#include <array>
+#include <cmath>
+#include <limits>
+
+// The six planes of a view-projection matrix (Gribb and Hartmann), normalized and pointing
+// inwards, for testing bounding volumes against what the matrix projects. The planes are kept
+// as a structure of arrays, padded to eight lanes with two that pass everything, so a test is a
+// few SIMD operations over all planes at once instead of a loop with an early out.
+class Frustum {
+public:
+    explicit Frustum(const glm::mat4& viewProjection) {
+        auto rows{glm::transpose(viewProjection)};
+        for (int i{0}; i < 6; i++) {
+            auto plane{i % 2 ? rows[3] - rows[i / 2] : rows[3] + rows[i / 2]};
+            plane /= glm::length(glm::vec3(plane));
+            x[i] = plane.x;
+            y[i] = plane.y;
+            z[i] = plane.z;
+            w[i] = plane.w;
+        }
+        for (int i{6}; i < lanes; i++) {
+            x[i] = y[i] = z[i] = 0.0f;
+            w[i] = std::numeric_limits<float>::max();
+        }
+    }
+
+    // false only when the sphere is entirely outside one of the planes
+    bool intersects(const glm::vec3& center, float radius) const {
+        auto outside{false};
+        for (int i{0}; i < lanes; i++)
+            outside |= x[i] * center.x + y[i] * center.y + z[i] * center.z + w[i] < -radius;
+        return !outside;
+    }
+
+    // false only when the box is entirely outside one of the planes: its corner furthest along
+    // the plane normal is behind it
+    bool intersects(const Aabb& box) const {
+        auto center{box.center()}, extent{box.extent()};
+        auto outside{false};
+        for (int i{0}; i < lanes; i++) {
+            auto distance{x[i] * center.x + y[i] * center.y + z[i] * center.z + w[i]};
+            auto reach{std::abs(x[i]) * extent.x + std::abs(y[i]) * extent.y +
+                       std::abs(z[i]) * extent.z};
+            outside |= distance + reach < 0.0f;
+        }
+        return !outside;
+    }
+
+private:
+    static constexpr int lanes{8};
+    alignas(32) std::array<float, lanes> x, y, z, w;
+};
+
+#endif
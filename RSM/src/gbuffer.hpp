@@ -0,0 +1,73 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+
+// Thin g-buffer of the deferred path: view space normal (octahedral RG16_SNORM), albedo and
+// depth. World position is rebuilt from depth, so one lighting pass shades every visible pixel
+// exactly once.
+class GBuffer {
+public:
+    GLuint fbo;
+    GLuint normalMap, albedoMap, depthMap;
+
+    GBuffer() : width{0}, height{0} {
+        normalMap = create();
+        albedoMap = create();
+        depthMap = create();
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normalMap, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, albedoMap, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+        GLenum drawBuffers[]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, drawBuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    GBuffer(const GBuffer&) = delete;
+
+    ~GBuffer() {
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &normalMap);
+        glDeleteTextures(1, &albedoMap);
+        glDeleteTextures(1, &depthMap);
+    }
+
+    // (re)allocates every map at `w` x `h`; nothing happens if that is the current size
+    void resize(unsigned w, unsigned h) {
+        if (w == width && h == height) return;
+        width = w;
+        height = h;
+        specify(normalMap, GL_RG16_SNORM, GL_RG, GL_FLOAT);
+        specify(albedoMap, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        specify(depthMap, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT);
+    }
+
+private:
+    unsigned width, height;
+
+    static GLuint create() {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // read with texelFetch only
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void specify(GLuint texture, GLint internalFormat, GLenum format, GLenum type) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+    }
+};
+
+#endif
@@ -0,0 +1,117 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef INDIRECT_TARGET_H
+#define INDIRECT_TARGET_H
+
+#include <glad/glad.h>
+
+#include <array>
+
+// Render targets of indirect lighting computed below screen resolution. The geometry pass
+// writes world position (distance to the camera in w) and normal, the gather pass reads them
+// and writes the indirect light, and the main pass upsamples that against its own geometry.
+// With temporal accumulation the gather result is blended into one of two history maps
+// (ping-pong: the other holds the previous frame) and the main pass upsamples that instead.
+class IndirectTarget {
+public:
+    GLuint geometryFbo, indirectFbo;
+    GLuint positionMap, normalMap, indirectMap;
+    // accumulated indirect light, camera distance in w
+    std::array<GLuint, 2> historyFbo, historyMap;
+    // cleared by resize, the history has to be rebuilt from scratch then
+    bool historyValid;
+
+    IndirectTarget() : historyValid{false}, width{0}, height{0}, historyIndex{0} {
+        glGenFramebuffers(1, &geometryFbo);
+        glGenFramebuffers(1, &indirectFbo);
+        glGenTextures(1, &positionMap);
+        glGenTextures(1, &normalMap);
+        glGenTextures(1, &indirectMap);
+        glGenFramebuffers(2, historyFbo.data());
+        glGenTextures(2, historyMap.data());
+        glGenRenderbuffers(1, &depthBuffer);
+    }
+    IndirectTarget(const IndirectTarget&) = delete;
+
+    ~IndirectTarget() {
+        glDeleteFramebuffers(1, &geometryFbo);
+        glDeleteFramebuffers(1, &indirectFbo);
+        glDeleteTextures(1, &positionMap);
+        glDeleteTextures(1, &normalMap);
+        glDeleteTextures(1, &indirectMap);
+        glDeleteFramebuffers(2, historyFbo.data());
+        glDeleteTextures(2, historyMap.data());
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+
+    unsigned getWidth() const {
+        return width;
+    }
+    unsigned getHeight() const {
+        return height;
+    }
+
+    // history written this frame and the one holding the previous frame
+    int currentHistory() const {
+        return historyIndex;
+    }
+    int previousHistory() const {
+        return historyIndex ^ 1;
+    }
+    void swapHistory() {
+        historyIndex ^= 1;
+    }
+
+    // (re)allocates every target at `w` x `h`; nothing happens if that is the current size
+    void resize(unsigned w, unsigned h) {
+        if (w == width && h == height) return;
+        width = w;
+        height = h;
+        // all formats are color-renderable in core 3.3
+        allocate(positionMap, GL_RGBA32F, GL_RGBA);
+        allocate(normalMap, GL_RGBA16F, GL_RGBA);
+        allocate(indirectMap, GL_R11F_G11F_B10F, GL_RGB);
+        for (auto history : historyMap) allocate(history, GL_RGBA16F, GL_RGBA);
+        historyValid = false;
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, geometryFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, positionMap, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalMap, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                                  depthBuffer);
+        GLenum drawBuffers[]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, drawBuffers);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, indirectFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, indirectMap, 0);
+        for (int i{0}; i < 2; i++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, historyFbo[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                   historyMap[i], 0);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+private:
+    GLuint depthBuffer;
+    unsigned width, height;
+    int historyIndex;
+
+    void allocate(GLuint texture, GLint internalFormat, GLenum format) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT,
+                     nullptr);
+        // read with texelFetch only
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+};
+
+#endif
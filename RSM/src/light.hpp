@@ -3,23 +3,11 @@
 
 #include <array>
 
+#include "embedded_shaders.h"
+#include "program_cache.h"
+
 class Light {
 private:
-    static constexpr const char* const vertCode{R"(
-#version 330 core
-layout (location = 0) in vec3 aPos;
-uniform mat4 MVP;
-void main() {
-    gl_Position = MVP * vec4(aPos.x, aPos.y, aPos.z, 1.0);
-}
-)"};
-    static constexpr const char* const fragCode{R"(
-#version 330 core
-out vec4 FragColor;
-uniform vec3 color;
-void main() {
-    FragColor = vec4(color, 1.0);
-})"};
     std::array<float, 3> vertices;
     float width;
 
@@ -33,24 +21,10 @@ public:
     : vertices{position.x, position.y, position.z} {
         glPointSize(width);
 
-        // vertex shader
-        int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertCode, nullptr);
-        glCompileShader(vertexShader);
-
-        // fragment shader
-        int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragCode, nullptr);
-        glCompileShader(fragmentShader);
-
-        // link shaders
-        shaderProgram = glCreateProgram();
-        glAttachShader(shaderProgram, vertexShader);
-        glAttachShader(shaderProgram, fragmentShader);
-        glLinkProgram(shaderProgram);
-
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        shaderProgram = ProgramCache::submit({
+            {GL_VERTEX_SHADER, embeddedShader("light_indicator.vert")},
+            {GL_FRAGMENT_SHADER, embeddedShader("light_indicator.frag")},
+        });
 
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -64,6 +38,7 @@ public:
     }
 
     int draw() {
+        if (!ProgramCache::ready(shaderProgram)) return 0;
         glUseProgram(shaderProgram);
         glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "MVP"), 1, GL_FALSE, &mvp[0][0]);
         glUniform3fv(glGetUniformLocation(shaderProgram, "color"), 1, &color[0]);
@@ -0,0 +1,107 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef LIGHT_BUDGET_H
+#define LIGHT_BUDGET_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <vector>
+
+// Splits the rsm budget of a frame between lights by how much each adds to the image. The
+// budget is what the quality settings give one light, times the number of lights: rsm layers of
+// `maxSize` squared texels and `maxSamples` gather samples per pixel. A light's share is its
+// brightness times the part of the view it lights; its rsm area and its samples follow the
+// share, but never go above the single light settings or below a floor. A point light spreads
+// its area over six faces.
+//
+// Sizes are quantized to eighths of `maxSize`, so a moving camera seldom changes them: every
+// change re-renders that light's static rsm.
+class LightBudget {
+public:
+    struct Allocation {
+        unsigned rsmSize;
+        unsigned sampleNum;
+    };
+
+    // how much the light with the face matrices `lightSpaces` and `diffuse` shows in the camera
+    // view: the share of a fixed set of points in the camera frustum that fall into one of its
+    // faces, times luminance
+    static float contribution(const glm::mat4& inverseViewProjection,
+                              std::span<const glm::mat4> lightSpaces, const glm::vec3& diffuse) {
+        constexpr int grid{8};
+        // fractions of the way from the near to the far plane; the scene fills the front of
+        // the camera frustum
+        constexpr std::array depths{0.02f, 0.08f, 0.2f, 0.4f};
+        auto unproject{[&](float x, float y, float z) {
+            auto world{inverseViewProjection * glm::vec4(x, y, z, 1.0f)};
+            return glm::vec3(world) / world.w;
+        }};
+        auto covered{0};
+        for (int y{0}; y < grid; y++) {
+            for (int x{0}; x < grid; x++) {
+                auto ndcX{(x + 0.5f) / grid * 2.0f - 1.0f}, ndcY{(y + 0.5f) / grid * 2.0f - 1.0f};
+                auto near{unproject(ndcX, ndcY, -1.0f)}, far{unproject(ndcX, ndcY, 1.0f)};
+                for (auto depth : depths) {
+                    auto position{glm::vec4(glm::mix(near, far, depth), 1.0f)};
+                    if (std::ranges::any_of(lightSpaces, [&](const glm::mat4& lightSpace) {
+                            auto clip{lightSpace * position};
+                            return clip.w > 0.0f && std::abs(clip.x) <= clip.w &&
+                                   std::abs(clip.y) <= clip.w && std::abs(clip.z) <= clip.w;
+                        }))
+                        covered++;
+                }
+            }
+        }
+        auto luminance{glm::dot(diffuse, glm::vec3(0.2126f, 0.7152f, 0.0722f))};
+        return luminance * covered / (grid * grid * depths.size());
+    }
+
+    // rsm size (of each face) and sample count of each light from its contribution and its
+    // number of faces
+    static std::vector<Allocation> allocate(const std::vector<float>& contributions,
+                                            const std::vector<int>& faceCounts, unsigned maxSize,
+                                            unsigned maxSamples) {
+        auto total{0.0f};
+        for (auto contribution : contributions) total += contribution;
+        auto count{static_cast<float>(contributions.size())};
+        auto minSamples{std::max(maxSamples / 8, 1u)};
+
+        std::vector<Allocation> allocations;
+        for (std::size_t i{0}; i < contributions.size(); i++) {
+            // share of the budget, relative to what one light of an evenly lit scene gets
+            auto share{total > 0.0f ? contributions[i] / total * count : 1.0f};
+            auto samples{static_cast<unsigned>(maxSamples * share)};
+            allocations.push_back({faceSize(share, faceCounts[i], maxSize),
+                                   std::clamp(samples, minSamples, maxSamples)});
+        }
+        return allocations;
+    }
+
+    // the largest rsm size allocate() can give a face of any of the lights with `faceCounts`:
+    // a light's share is at most the number of lights, when it is the only one seen
+    static unsigned largestSize(const std::vector<int>& faceCounts, unsigned maxSize) {
+        auto largest{0u};
+        for (auto faces : faceCounts) {
+            largest = std::max(largest,
+                               faceSize(static_cast<float>(faceCounts.size()), faces, maxSize));
+        }
+        return largest;
+    }
+
+private:
+    static unsigned faceSize(float share, int faces, unsigned maxSize) {
+        auto step{std::max(maxSize / 8, 1u)};
+        auto minSize{std::max(maxSize / 4, step)};
+        auto size{static_cast<unsigned>(maxSize * std::sqrt(share / faces)) / step * step};
+        return std::clamp(size, minSize, maxSize);
+    }
+};
+
+#endif
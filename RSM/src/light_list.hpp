@@ -0,0 +1,85 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef LIGHT_LIST_H
+#define LIGHT_LIST_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+// The lights of the frame with their rsm settings, shared by every program through one std140
+// uniform block:
+//
+//     struct RsmLight {
+//         mat4 lightSpaceMatrices[6];         // per rsm face
+//         mat4 inverseLightSpaceMatrices[6];  // light clip space back to world
+//         vec4 position;  // xyz
+//         vec4 diffuse;   // rgb
+//         vec2 rsmScale;  // share of its layers of the rsm arrays the light's rsm faces cover
+//         float rsmSampleShare;  // share of a variant's RSM_SAMPLE_NUM the light's gather takes
+//         int firstLayer;  // of its faces in the rsm arrays
+//         int faceCount;   // 1 for a spotlight, 6 for a point light
+//     };
+//     layout (std140) uniform LightList {
+//         RsmLight lights[4];
+//         int lightCount;
+//     };
+//
+// A spotlight has one rsm face, a point light the six faces of a cube in the order +x, -x, +y,
+// -y, +z, -z, each in its own layer of the rsm arrays.
+class LightList {
+public:
+    static constexpr GLuint binding{3};
+    static constexpr const char* const blockName{"LightList"};
+    // MAX_LIGHTS of light_list.glsl
+    static constexpr int maxLights{4};
+    static constexpr int cubeFaces{6};
+
+    struct RsmLight {
+        std::array<glm::mat4, cubeFaces> lightSpaceMatrices;
+        std::array<glm::mat4, cubeFaces> inverseLightSpaceMatrices;
+        glm::vec4 position;
+        glm::vec4 diffuse;
+        glm::vec2 rsmScale;
+        float rsmSampleShare;
+        GLint firstLayer;
+        GLint faceCount;
+        GLint padding[3];
+    };
+    static_assert(sizeof(RsmLight) == (2 * cubeFaces * 16 + 2 * 4 + 8) * sizeof(float));
+
+    struct Block {
+        std::array<RsmLight, maxLights> lights;
+        GLint lightCount;
+        GLint padding[3];
+    };
+    static_assert(sizeof(Block) == sizeof(RsmLight) * maxLights + 4 * sizeof(GLint));
+
+    // writes this frame's lights
+    static void update(const Block& block) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer());
+        // orphaned each time, like DrawConstants
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(block), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+    }
+
+private:
+    static GLuint buffer() {
+        static const GLuint ubo{[] {
+            GLuint ubo;
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_STREAM_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+            return ubo;
+        }()};
+        return ubo;
+    }
+};
+
+#endif
@@ -7,9 +7,11 @@
 #include <GLFW/glfw3.h>
 
 #include <cmath>
-#include <random>
-#include <numbers>
+#include <algorithm>
 #include <array>
+#include <numbers>
+#include <span>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -17,7 +19,21 @@
 
 #include "camera.h"
 #include "shader.h"
+#include "program_cache.h"
 #include "model.hpp"
+#include "draw_constants.hpp"
+#include "frame_constants.hpp"
+#include "indirect_target.hpp"
+#include "gbuffer.hpp"
+#include "rsm_target.hpp"
+#include "scene_target.hpp"
+#include "dynamic_resolution.hpp"
+#include "sample_sets.h"
+#include "vpl_lights.h"
+#include "light_list.hpp"
+#include "light_budget.hpp"
+#include "frustum.hpp"
+#include "occlusion_culling.h"
 #include "light.hpp"
 
 #include <imgui.h>
@@ -28,38 +44,152 @@
 constexpr const auto SCR_WIDTH{800u};
 constexpr const auto SCR_HEIGHT{600u};
 
-// shadow map size
-constexpr const auto RSM_WIDTH{1024u};
-constexpr const auto RSM_HEIGHT{1024u};
+// shadow map sizes (square) offered in the ui
+constexpr const std::array RSM_SIZE_CHOICES{256u, 512u, 1024u, 2048u};
+auto rsmSizeChoice{2};
+// resolution of the camera passes relative to the window; below 1 they render off-screen and
+// are scaled up
+constexpr const std::array RENDER_SCALE_CHOICES{1.0f, 0.75f, 0.5f, 0.35f};
+auto renderScaleChoice{0};
 
 // rsm sample settings
 constexpr const auto MAX_SAMPLE_NUM{256u};
 constexpr const auto MAX_SAMPLE_RADIUS{0.3f};
+// the sample offsets are a Sobol set, rotated per pixel by a tiled blue noise texture, both with
+// a fixed seed (sample_sets.h); tools/sample_benchmark.cpp measures the error of each count
+// sample counts offered in the ui, each one is its own specialized main shader
+constexpr const std::array SAMPLE_NUM_CHOICES{16u, 32u, 64u, 128u, 256u};
+auto sampleNumChoice{static_cast<int>(SAMPLE_NUM_CHOICES.size()) - 1};
+
+// rsm layouts, switchable in the ui to compare them. The reference one stores normal and world
+// position as RGB32F next to the depth and an 8 bit flux; the compact one rebuilds the position
+// from depth and keeps an octahedral RG16_SNORM normal and an R11F_G11F_B10F flux.
+auto rsmCompact{true};
+// bytes behind one rsm texel, and behind one indirect lighting sample (depth is not read by
+// the reference layout there)
+constexpr const auto RSM_REFERENCE_TEXEL_BYTES{4u + 12u + 12u + 3u};
+constexpr const auto RSM_REFERENCE_SAMPLE_BYTES{12u + 12u + 3u};
+constexpr const auto RSM_COMPACT_TEXEL_BYTES{4u + 4u + 4u};
+constexpr const auto RSM_COMPACT_SAMPLE_BYTES{4u + 4u + 4u};
+// memory the rsm targets may take together; past it the size the lights share is halved
+constexpr const auto RSM_MEMORY_BUDGET{512ull * 1024 * 1024};
+
+// indirect lighting resolution divisors offered in the ui; above 1 the rsm gather runs once per
+// texel of a low resolution image that the main pass upsamples
+constexpr const std::array INDIRECT_DOWNSAMPLE_CHOICES{1u, 2u, 4u};
+auto indirectDownsampleChoice{0};
+
+// temporal accumulation: each frame gathers 1/TEMPORAL_FRAMES of the chosen rsm samples
+// (a block of it per frame and pixel tile, so TEMPORAL_FRAMES frames cover the whole set) and
+// blends them into the reprojected history. Runs through the indirect targets, also at full
+// resolution.
+constexpr const auto TEMPORAL_FRAMES{16u};
+auto temporalIndirect{false};
+// share of the history in each blend, ~1/(1 - w) frames of memory
+constexpr const auto TEMPORAL_HISTORY_WEIGHT{0.9f};
+
+// virtual point lights instead of the rsm samples: the rsm is reduced to a grid of lights and
+// clustered down to a few dozen each frame (vpl_lights.h), which the gathers loop over without
+// reading the rsm. The clustering runs on the cpu a frame or two behind the rsm.
+auto vplIndirect{false};
+// closest a light counts as to a receiver, in world units
+constexpr const auto VPL_MIN_DISTANCE{1.0f};
+// the gather averages r^2 weighted samples over a disk of MAX_SAMPLE_RADIUS, with r uniform; one
+// cell of the grid is 1/GRID^2 of the rsm, which the mean weight of 2/3 over that disk turns
+// into this much of the gather's flux
+constexpr const auto VPL_FLUX_SCALE{1.0f / (VplLights::GRID * VplLights::GRID) /
+                                    (3.0f * std::numbers::pi_v<float> *
+                                     MAX_SAMPLE_RADIUS * MAX_SAMPLE_RADIUS)};
+
+// shadow filtering modes of shading.glsl (SHADOW_FILTER), in ui order; the camera pass time of
+// each is shown once it has been used
+constexpr const std::array SHADOW_FILTER_NAMES{"Hard", "Hardware PCF", "Poisson PCF", "PCSS"};
+auto shadowFilter{1};
+// PCSS light size, in rsm uv
+constexpr const auto SHADOW_LIGHT_SIZE{0.02f};
+
+// dynamic resolution: quality levels from best to cheapest as choices of the settings above, the
+// controller steps through them to hold a gpu frame time
+struct QualityLevel {
+    int rsmSizeChoice;
+    int sampleNumChoice;
+    int renderScaleChoice;
+};
+constexpr const std::array QUALITY_LEVELS{
+    QualityLevel{2, 4, 0}, QualityLevel{2, 3, 0}, QualityLevel{2, 2, 0},
+    QualityLevel{1, 2, 0}, QualityLevel{1, 2, 1}, QualityLevel{1, 1, 1},
+    QualityLevel{1, 1, 2}, QualityLevel{0, 0, 2}, QualityLevel{0, 0, 3},
+};
+auto dynamicResolution{true};
+
+// deferred: a thin g-buffer pass, then lighting and the rsm gather once per visible pixel;
+// forward: every rasterized fragment is lit, overdrawn ones included
+auto deferredShading{false};
+// skip camera pass draws hidden behind the depth of an earlier frame, see OcclusionCulling
+auto occlusionCulling{false};
 
 // camera settings
 Camera camera({-40.0f, 15.0f, 15.0f});
+auto cameraNearPlane{0.1f};
+auto cameraFarPlane{100.0f};
 
 auto deltaTime{0.0f};
 
-// light settings
-glm::vec3 lightPos(-20.0f, 20.0f, 20.0f);
-glm::vec3 lightDiffuse(0.6f, 0.6f, 0.6f);
+// light settings: spotlights aimed at the origin or point lights, the first lightCount of them
+// on. A spotlight has one layer in the rsm arrays, a point light six, a cube face each; the rsm
+// budget of the quality settings is split between them by LightBudget.
+struct SceneLight {
+    glm::vec3 position;
+    glm::vec3 diffuse;
+    bool point;
+};
+std::array<SceneLight, LightList::maxLights> sceneLights{{
+    {{-20.0f, 20.0f, 20.0f}, {0.6f, 0.6f, 0.6f}, false},
+    {{20.0f, 25.0f, 15.0f}, {0.45f, 0.35f, 0.25f}, false},
+    {{-25.0f, 15.0f, -15.0f}, {0.2f, 0.3f, 0.45f}, false},
+    {{-8.0f, 18.0f, 8.0f}, {0.3f, 0.3f, 0.3f}, true},
+}};
+// view direction and up vector of each cube face of a point light, in the face order of
+// LightList
+const std::array<std::array<glm::vec3, 2>, LightList::cubeFaces> CUBE_FACES{{
+    {{{1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}}},
+    {{{-1.0f, 0.0f, 0.0f}, {0.0f, -1.0f, 0.0f}}},
+    {{{0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}},
+    {{{0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}},
+    {{{0.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f}}},
+    {{{0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}}},
+}};
+auto lightCount{1};
+// the light the ui edits
+auto selectedLight{0};
 auto lightNearPlane{0.1f};
 auto lightFarPlane{100.0f};
 
 // how strong rsm is
 auto indirectWeight{60.0f};
 
+// largest error on screen, in pixels, of the model's levels of detail in the camera passes and
+// in the rsm, which only feeds shadows and a blurry gather and so may go coarser
+auto lodPixelError{1.0f};
+auto rsmLodPixelError{4.0f};
+
 static void processInput(GLFWwindow* window);
 static void mouseCallback(GLFWwindow* window, double xpos, double ypos);
 static void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
 GLuint createRandomTexture(std::size_t size);
+GLuint createBlueNoiseTexture(int size);
 
 class Planes {
     GLuint groundVao, backwallVao, rightwallVao;
     GLuint groundVbo, backwallVbo, rightwallVbo;
     GLuint groundEbo, backwallEbo, rightwallEbo;
+    // model space bounds of ground, backwall and rightwall
+    std::array<Aabb, 3> boxes;
+
+    static glm::mat4 transform() {
+        return glm::scale(glm::mat4(1.0f), {5, 5, 5});
+    }
 
 public:
     Planes() {
@@ -86,6 +216,12 @@ public:
              0.0f, 5.0f, 0.0f, -1.0f, 0.0f, 0.0f
         };
         // clang-format on
+        for (auto [box, vertices] : {std::pair{&boxes[0], &groundVertices},
+                                     std::pair{&boxes[1], &backwallVertices},
+                                     std::pair{&boxes[2], &rightwallVertices}}) {
+            for (std::size_t i{0}; i < vertices->size(); i += 6)
+                box->add({(*vertices)[i], (*vertices)[i + 1], (*vertices)[i + 2]});
+        }
         GLuint planeEbo[]{0, 1, 3, 1, 2, 3};
         // ground
         glGenVertexArrays(1, &groundVao);
@@ -136,20 +272,37 @@ public:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rightwallEbo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(planeEbo), planeEbo, GL_STATIC_DRAW);
     }
-    void draw(Shader& shader) {
+    // draws each plane whose box is inside one of `frustums` and not hidden by `occlusion` if
+    // given
+    DrawStats draw(Shader& shader, const glm::mat4& viewProjection,
+                   std::span<const Frustum> frustums, OcclusionCulling* occlusion = nullptr) {
         shader.use();
 
-        shader.setUniform("model", glm::scale(glm::mat4(1.0f), {5, 5, 5}));
+        DrawConstants::set(transform(), viewProjection);
+        DrawStats stats;
+        auto drawPlane{[&](const Aabb& box, GLuint vao, const glm::vec3& diffuse) {
+            auto worldBox{box.transformed(transform())};
+            if (std::ranges::none_of(frustums, [&](const Frustum& frustum) {
+                    return frustum.intersects(worldBox);
+                })) {
+                stats.culled++;
+                return;
+            }
+            if (occlusion && !occlusion->visible(&box, worldBox)) {
+                stats.occluded++;
+                return;
+            }
+            glBindVertexArray(vao);
+            shader.setUniform("material.diffuse", diffuse.x, diffuse.y, diffuse.z);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            stats.draws++;
+            stats.triangles += 2;
+        }};
         // plane colors
-        glBindVertexArray(groundVao);
-        shader.setUniform("material.diffuse", 0.0f, 0.0f, 0.8f);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(backwallVao);
-        shader.setUniform("material.diffuse", 0.0f, 0.8f, 0.0f);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(rightwallVao);
-        shader.setUniform("material.diffuse", 0.8f, 0.0f, 0.0f);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        drawPlane(boxes[0], groundVao, {0.0f, 0.0f, 0.8f});
+        drawPlane(boxes[1], backwallVao, {0.0f, 0.8f, 0.0f});
+        drawPlane(boxes[2], rightwallVao, {0.8f, 0.0f, 0.0f});
+        return stats;
     }
 };
 
@@ -188,123 +341,424 @@ int main() {
     glfwSetCursorPosCallback(window, mouseCallback);
     glfwSetScrollCallback(window, scrollCallback);
 
-    // two shaders in rsm
-    Shader mainShader("./main_shader.vert", "./main_shader.frag");
-    Shader lightSpaceShader("./light_space_shader.vert", "./light_space_shader.frag");
+    ProgramCache::bindUniformBlock(DrawConstants::blockName, DrawConstants::binding);
+    ProgramCache::bindUniformBlock(FrameConstants::blockName, FrameConstants::binding);
+    ProgramCache::bindUniformBlock(VplLights::blockName, VplLights::binding);
+    ProgramCache::bindUniformBlock(LightList::blockName, LightList::binding);
+
+    // two shaders in rsm, compiled in the background while the model loads; the main pass is
+    // drawn with plain lambert until its shader is ready
+    Shader fallbackShader("./main_shader.vert", "./fallback_shader.frag");
+    ShaderPermutations mainShader("./main_shader.vert", "./main_shader.frag", &fallbackShader);
+    auto mainVariant{[](unsigned sampleNum, bool compact, bool upsample, int shadowFilter,
+                        bool vpl) {
+        auto defines{vpl ? ShaderDefines{{"RSM_VPL", "1"}}
+                         : ShaderDefines{{"RSM_SAMPLE_NUM", std::to_string(sampleNum)}}};
+        if (compact) defines.emplace("RSM_COMPACT", "1");
+        if (upsample) defines.emplace("RSM_UPSAMPLE", "1");
+        if (shadowFilter) defines.emplace("SHADOW_FILTER", std::to_string(shadowFilter));
+        return defines;
+    }};
+    auto rsmVariant{[](bool compact) {
+        return compact ? ShaderDefines{{"RSM_COMPACT", "1"}} : ShaderDefines{};
+    }};
+    // the gather of the indirect pass, one block of the samples when accumulating
+    auto indirectVariant{[&](unsigned sampleNum, bool compact, bool temporal, bool vpl) {
+        if (!temporal || vpl) return mainVariant(sampleNum, compact, false, 0, vpl);
+        auto defines{
+            mainVariant(std::max(sampleNum / TEMPORAL_FRAMES, 1u), compact, false, 0, false)};
+        defines.emplace("RSM_SAMPLE_BLOCKS", std::to_string(TEMPORAL_FRAMES));
+        return defines;
+    }};
+    auto upsample{INDIRECT_DOWNSAMPLE_CHOICES[indirectDownsampleChoice] > 1 || temporalIndirect};
+    mainShader.select(mainVariant(SAMPLE_NUM_CHOICES[sampleNumChoice], rsmCompact, upsample,
+                                  shadowFilter, vplIndirect));
+    // the others are built in the background, so switching in the ui does not stall
+    for (auto compact : {rsmCompact, !rsmCompact}) {
+        for (auto sampleNum : SAMPLE_NUM_CHOICES)
+            mainShader.prepare(mainVariant(sampleNum, compact, upsample, shadowFilter, false));
+        mainShader.prepare(mainVariant(0, compact, upsample, shadowFilter, true));
+    }
+    // every face of a light's rsm in one pass, light_space_shader.geom routes them to their layers
+    ShaderPermutations lightSpaceShader("./light_space_shader.vert", "./light_space_shader.geom",
+                                        "./light_space_shader.frag");
+    lightSpaceShader.select(rsmVariant(rsmCompact));
+    lightSpaceShader.prepare(rsmVariant(!rsmCompact));
+    // low resolution indirect lighting: geometry of the camera view, then one gather per texel
+    Shader geometryShader("./main_shader.vert", "./geometry_shader.frag");
+    ShaderPermutations indirectShader("./fullscreen.vert", "./indirect_shader.frag");
+    indirectShader.select(indirectVariant(SAMPLE_NUM_CHOICES[sampleNumChoice], rsmCompact,
+                                          temporalIndirect, vplIndirect));
+    Shader temporalShader("./fullscreen.vert", "./temporal_shader.frag");
+    // deferred path, same variants as the main shader
+    Shader gbufferShader("./main_shader.vert", "./gbuffer_shader.frag");
+    ShaderPermutations deferredShader("./fullscreen.vert", "./deferred_shader.frag");
+    deferredShader.select(mainVariant(SAMPLE_NUM_CHOICES[sampleNumChoice], rsmCompact, upsample,
+                                      shadowFilter, vplIndirect));
+    // reduction of the rsm to virtual point lights
+    ShaderPermutations vplExtractShader("./fullscreen.vert", "./vpl_extract.frag");
+    vplExtractShader.select(rsmVariant(rsmCompact));
+    vplExtractShader.prepare(rsmVariant(!rsmCompact));
+    // occlusion culling: depth pyramid levels, and the boxes of its borderline draws
+    Shader hiZReduceShader("./fullscreen.vert", "./hiz_reduce.frag");
+    Shader occlusionBoxShader("./occlusion_box.vert", "./occlusion_box.frag");
 
     // things to render in each frame
     Planes planes;
     Model mainModel("./lumine.fbx");
-    Light lightIndicator(lightPos, 5.0f);
-
-    // create rsm framebuffers
-    GLuint rsmFBO;
-    GLuint depthMap, normalMap, worldPosMap, fluxMap;
-    glGenFramebuffers(1, &rsmFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, rsmFBO);
-    // create textures for rsm
-    const glm::vec4 all1(1.0f, 1.0f, 1.0f, 1.0f);
-    const glm::vec4 all0(0.0f, 0.0f, 0.0f, 0.0f);
-    // depth
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, RSM_WIDTH, RSM_HEIGHT, 0, GL_DEPTH_COMPONENT,
-                 GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, reinterpret_cast<const float*>(&all0));
-    // normal
-    glGenTextures(1, &normalMap);
-    glBindTexture(GL_TEXTURE_2D, normalMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, RSM_WIDTH, RSM_HEIGHT, 0, GL_RGB, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, reinterpret_cast<const float*>(&all0));
-    // world coordinate
-    glGenTextures(1, &worldPosMap);
-    glBindTexture(GL_TEXTURE_2D, worldPosMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, RSM_WIDTH, RSM_HEIGHT, 0, GL_RGB, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, reinterpret_cast<const float*>(&all1));
-    // light flux
-    glGenTextures(1, &fluxMap);
-    glBindTexture(GL_TEXTURE_2D, fluxMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, RSM_WIDTH, RSM_HEIGHT, 0, GL_RGB, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, reinterpret_cast<const float*>(&all0));
-
-    // bind textures to framebuffers (set light_space_shader output)
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normalMap, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, worldPosMap, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, fluxMap, 0);
+    // moved to each light in turn
+    Light lightIndicator(sceneLights[0].position, 5.0f);
 
-    GLenum rsmDrawBuffers[]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-    glDrawBuffers(3, rsmDrawBuffers);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // rsm targets, a layer per face of each light: the one the gathers read, and the planes
+    // alone. The planes never move, so their rsm is only re-rendered when the light moves; a
+    // light's layers start from a copy of it and add the animated model on top, and are left as
+    // they are while the model is out of the light's view.
+    auto rsmFaceCounts{[] {
+        std::vector<int> faceCounts;
+        for (int i{0}; i < lightCount; i++)
+            faceCounts.push_back(sceneLights[i].point ? LightList::cubeFaces : 1);
+        return faceCounts;
+    }};
+    auto rsmLayerCount{[&] {
+        auto layers{0};
+        for (auto faces : rsmFaceCounts()) layers += faces;
+        return layers;
+    }};
+    // the size the lights share, the size choice unless the layers the budget can fill at it
+    // would take more than RSM_MEMORY_BUDGET in the current layout. Layers are as large as the
+    // largest face the budget can hand out, not the size choice.
+    auto rsmBudgetSize{[&] {
+        auto faceCounts{rsmFaceCounts()};
+        auto texelBytes{rsmCompact ? RSM_COMPACT_TEXEL_BYTES : RSM_REFERENCE_TEXEL_BYTES};
+        auto size{RSM_SIZE_CHOICES[rsmSizeChoice]};
+        while (size > RSM_SIZE_CHOICES[0]) {
+            auto side{LightBudget::largestSize(faceCounts, size)};
+            if (2ull * texelBytes * side * side * rsmLayerCount() <= RSM_MEMORY_BUDGET) break;
+            size /= 2;
+        }
+        return size;
+    }};
+    auto lightBudgetSize{rsmBudgetSize()};
+    auto rsmSize{LightBudget::largestSize(rsmFaceCounts(), lightBudgetSize)};
+    RsmTarget rsm(rsmSize, rsmSize, rsmLayerCount(), rsmCompact);
+    RsmTarget staticRsm(rsmSize, rsmSize, rsmLayerCount(), rsmCompact);
+    // what each light's layers were rendered with; invalid after a layout or size switch
+    struct RsmLayer {
+        std::array<glm::mat4, LightList::cubeFaces> lightSpaces{};
+        unsigned size{0};
+        bool staticValid{false};
+        bool modelDrawn{false};
+    };
+    std::array<RsmLayer, LightList::maxLights> rsmLayers{};
+    auto invalidateRsmLayers{[&] {
+        for (auto& layer : rsmLayers) layer.staticValid = false;
+    }};
 
-    // create random texture for random sampling
+    // sample offsets of the rsm gather and their per-pixel rotation
     GLuint randomMap = createRandomTexture(MAX_SAMPLE_NUM);
+    GLuint blueNoiseMap{createBlueNoiseTexture(BLUE_NOISE_SIZE)};
+    // clustered lights of the vpl gather
+    VplLights vplLights(VPL_MIN_DISTANCE, LightList::maxLights * LightList::cubeFaces);
 
     // bind textures
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, rsm.depthMap);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, normalMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, rsm.normalMap);
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, worldPosMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, rsm.worldPosMap);
     glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, fluxMap);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, rsm.fluxMap);
     glActiveTexture(GL_TEXTURE4);
     glBindTexture(GL_TEXTURE_2D, randomMap);
+    glActiveTexture(GL_TEXTURE13);
+    glBindTexture(GL_TEXTURE_2D, blueNoiseMap);
+    // the rsm depth once more, through a sampler object with depth compare for the shadow
+    // filters; the gathers read the same texture as plain depth on unit 0. The border stays 0,
+    // like the map's, so outside the rsm is in shadow either way.
+    GLuint shadowSampler;
+    glGenSamplers(1, &shadowSampler);
+    glSamplerParameteri(shadowSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glSamplerParameteri(shadowSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glSamplerParameteri(shadowSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glSamplerParameteri(shadowSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glSamplerParameteri(shadowSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glSamplerParameteri(shadowSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glActiveTexture(GL_TEXTURE14);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, rsm.depthMap);
+    glBindSampler(14, shadowSampler);
+
+    // low resolution targets, allocated once a divisor above 1 or accumulation is chosen. Unit 7
+    // is what the main pass upsamples: the raw gather, or when accumulating the history written
+    // this frame (rebound every frame); unit 11 is the raw gather and 12 the previous history.
+    IndirectTarget indirectTarget;
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D, indirectTarget.positionMap);
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, indirectTarget.normalMap);
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D, indirectTarget.indirectMap);
+    // deferred path targets
+    GBuffer gbuffer;
+    glActiveTexture(GL_TEXTURE8);
+    glBindTexture(GL_TEXTURE_2D, gbuffer.normalMap);
+    glActiveTexture(GL_TEXTURE9);
+    glBindTexture(GL_TEXTURE_2D, gbuffer.albedoMap);
+    glActiveTexture(GL_TEXTURE10);
+    glBindTexture(GL_TEXTURE_2D, gbuffer.depthMap);
+    glActiveTexture(GL_TEXTURE11);
+    glBindTexture(GL_TEXTURE_2D, indirectTarget.indirectMap);
+    // camera passes below window resolution
+    SceneTarget sceneTarget;
+    // fullscreen passes take their vertices from gl_VertexID, but core needs a vertex array
+    GLuint fullscreenVao;
+    glGenVertexArrays(1, &fullscreenVao);
+
+    // selects the program variants of the current ui settings
+    auto selectVariants{[&] {
+        auto sampleNum{SAMPLE_NUM_CHOICES[sampleNumChoice]};
+        auto indirectDownsample{INDIRECT_DOWNSAMPLE_CHOICES[indirectDownsampleChoice]};
+        lightSpaceShader.select(rsmVariant(rsmCompact));
+        vplExtractShader.select(rsmVariant(rsmCompact));
+        indirectShader.select(
+            indirectVariant(sampleNum, rsmCompact, temporalIndirect, vplIndirect));
+        for (auto shader : {&mainShader, &deferredShader}) {
+            shader->select(
+                mainVariant(sampleNum, rsmCompact, indirectDownsample > 1 || temporalIndirect,
+                            shadowFilter, vplIndirect));
+            shader->setUniform("indirectDownsample", static_cast<int>(indirectDownsample));
+        }
+    }};
+    // reallocates both rsm targets in the current layout for the size choice and a layer per
+    // light face
+    auto selectRsmSize{[&] {
+        lightBudgetSize = rsmBudgetSize();
+        auto size{LightBudget::largestSize(rsmFaceCounts(), lightBudgetSize)};
+        rsm.resize(size, size, rsmLayerCount(), rsmCompact);
+        staticRsm.resize(size, size, rsmLayerCount(), rsmCompact);
+        invalidateRsmLayers();
+    }};
+    // points the samplers and the programs at the rsm of `compact`'s layout, which is
+    // allocated in its place
+    auto selectRsmLayout{[&](bool compact) {
+        rsmCompact = compact;
+        selectRsmSize();
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, compact ? rsm.compactNormalMap : rsm.normalMap);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, compact ? rsm.compactFluxMap : rsm.fluxMap);
+        selectVariants();
+    }};
+    selectRsmLayout(rsmCompact);
+
+    // gpu time of the camera passes (low resolution indirect and main), read three frames late
+    // and only once the results are available so it never waits for the gpu; a frame whose
+    // results are still pending when its slot comes round again goes unmeasured
+    std::array<GLuint, 3> mainPassQueries;
+    glGenQueries(mainPassQueries.size(), mainPassQueries.data());
+    auto mainPassFrames{0u};
+    auto mainPassMs{0.0f};
+    // shadow filter of the frame each query measured, and the last time seen with each filter
+    std::array<int, mainPassQueries.size()> mainPassFilters{};
+    std::array<float, SHADOW_FILTER_NAMES.size()> shadowFilterMs{};
+    // gpu time of the whole frame for the dynamic resolution controller: timestamps at start
+    // and end, since an elapsed query cannot nest with the one above
+    std::array<std::array<GLuint, 2>, mainPassQueries.size()> frameTimestamps;
+    for (auto& timestamps : frameTimestamps) glGenQueries(2, timestamps.data());
+    auto frameMs{0.0f};
+    auto queryAvailable{[](GLuint query) {
+        GLuint available{GL_FALSE};
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        return available == GL_TRUE;
+    }};
+    DynamicResolution resolutionController(QUALITY_LEVELS.size(), 16.0f);
+    auto selectQualityLevel{[&](std::size_t level) {
+        rsmSizeChoice = QUALITY_LEVELS[level].rsmSizeChoice;
+        sampleNumChoice = QUALITY_LEVELS[level].sampleNumChoice;
+        renderScaleChoice = QUALITY_LEVELS[level].renderScaleChoice;
+        selectRsmSize();
+        selectVariants();
+    }};
 
-    // lightSpaceShader configuration
+    // projection of every spotlight, and of every cube face of a point light
+    const auto spotFovy{glm::radians(60.0f)}, cubeFovy{glm::radians(90.0f)};
     const glm::mat4 lightProjection = glm::perspective(
-        glm::radians(60.0f), 1.f * RSM_WIDTH / RSM_HEIGHT, lightNearPlane, lightFarPlane);
-    glm::mat4 lightView;
-
-    lightSpaceShader.use();
-    lightSpaceShader.setUniform("light.diffuse", lightDiffuse);
-
-    // mainShader configuration
-    mainShader.use();
-    mainShader.setUniform("material.ambient", 0.1f, 0.1f, 0.1f);
-    mainShader.setUniform("material.specular", 0.1f, 0.1f, 0.1f);
-    mainShader.setUniform("material.shininess", 8.0f);
-    mainShader.setUniform("light.ambient", 0.2f, 0.2f, 0.2f);
-    mainShader.setUniform("light.diffuse", lightDiffuse);
-    mainShader.setUniform("light.specular", 1.0f, 1.0f, 1.0f);
-    mainShader.setUniform("shadowNum", static_cast<int>(MAX_SAMPLE_NUM));
-    mainShader.setUniform("shadowRadius", MAX_SAMPLE_RADIUS);
-    mainShader.setUniform("shadowBias", 0.05f);
-
-    mainShader.setUniform("depthMap", 0);
-    mainShader.setUniform("normalMap", 1);
-    mainShader.setUniform("worldPosMap", 2);
-    mainShader.setUniform("fluxMap", 3);
-    mainShader.setUniform("randomMap", 4);
+        spotFovy, 1.0f, lightNearPlane, lightFarPlane);
+    const glm::mat4 cubeProjection = glm::perspective(
+        cubeFovy, 1.0f, lightNearPlane, lightFarPlane);
+
+    // mainShader and deferredShader configuration, both run shading.glsl
+    const glm::vec3 lightAmbient{0.2f, 0.2f, 0.2f};
+    for (auto shader : {&mainShader, &deferredShader}) {
+        shader->use();
+        shader->setUniform("material.ambient", 0.1f, 0.1f, 0.1f);
+        shader->setUniform("material.specular", 0.1f, 0.1f, 0.1f);
+        shader->setUniform("material.shininess", 8.0f);
+        shader->setUniform("light.ambient", lightAmbient);
+        shader->setUniform("light.specular", 1.0f, 1.0f, 1.0f);
+        shader->setUniform("shadowRadius", MAX_SAMPLE_RADIUS);
+        shader->setUniform("shadowBias", 0.05f);
+
+        shader->setUniform("depthMap", 0);
+        shader->setUniform("normalMap", 1);
+        shader->setUniform("worldPosMap", 2);
+        shader->setUniform("fluxMap", 3);
+        shader->setUniform("randomMap", 4);
+        shader->setUniform("blueNoiseMap", 13);
+        shader->setUniform("shadowMap", 14);
+        shader->setUniform("shadowLightSize", SHADOW_LIGHT_SIZE);
+        shader->setUniform("shadowLightPlanes", lightNearPlane, lightFarPlane);
+        shader->setUniform("geometryPositionMap", 5);
+        shader->setUniform("geometryNormalMap", 6);
+        shader->setUniform("indirectMap", 7);
+    }
+    deferredShader.setUniform("gNormalMap", 8);
+    deferredShader.setUniform("gAlbedoMap", 9);
+    deferredShader.setUniform("gDepthMap", 10);
+
+    // fallbackShader configuration; it only sees what is set through mainShader while the
+    // variant it stands in for is still compiling, material.diffuse comes with every draw
+    fallbackShader.use();
+    fallbackShader.setUniform("light.ambient", lightAmbient);
+
+    // indirectShader configuration
+    indirectShader.use();
+    indirectShader.setUniform("shadowRadius", MAX_SAMPLE_RADIUS);
+    indirectShader.setUniform("depthMap", 0);
+    indirectShader.setUniform("normalMap", 1);
+    indirectShader.setUniform("worldPosMap", 2);
+    indirectShader.setUniform("fluxMap", 3);
+    indirectShader.setUniform("randomMap", 4);
+    indirectShader.setUniform("blueNoiseMap", 13);
+    indirectShader.setUniform("geometryPositionMap", 5);
+    indirectShader.setUniform("geometryNormalMap", 6);
+
+    // vplExtractShader configuration
+    vplExtractShader.use();
+    vplExtractShader.setUniform("depthMap", 0);
+    vplExtractShader.setUniform("normalMap", 1);
+    vplExtractShader.setUniform("worldPosMap", 2);
+    vplExtractShader.setUniform("fluxMap", 3);
+    vplExtractShader.setUniform("vplGrid", VplLights::GRID);
+    vplExtractShader.setUniform("vplFluxScale", VPL_FLUX_SCALE);
+
+    // temporalShader configuration
+    temporalShader.use();
+    temporalShader.setUniform("geometryPositionMap", 5);
+    temporalShader.setUniform("currentIndirectMap", 11);
+    temporalShader.setUniform("previousHistoryMap", 12);
+    temporalShader.setUniform("historyWeight", TEMPORAL_HISTORY_WEIGHT);
+
+    // hiZReduceShader configuration; unit 15 is only bound while the pyramid is built
+    hiZReduceShader.use();
+    hiZReduceShader.setUniform("source", 15);
+    OcclusionCulling occlusion(cameraNearPlane, cameraFarPlane);
+    // camera of the frame the history was written in
+    glm::mat4 previousViewProjection{1.0f};
+    glm::vec3 previousViewPos{camera.position};
+    auto temporalFrame{0u};
+    // this frame's share of the rsm budget of each light, and how many layers were rendered
+    std::vector<LightBudget::Allocation> lightAllocations;
+    auto rsmLayersRendered{0};
+    // what the rsm, indirect geometry and camera passes drew and culled
+    DrawStats rsmStats, indirectStats, cameraStats;
+    // one-off comparison of the vpl gather with the full sample gather, asked for in the ui and
+    // run once both variants are compiled and lights have arrived; its timings are read back
+    // in a later frame, once available
+    auto vplComparePending{false};
+    auto vplCompareTiming{false};
+    std::array<GLuint, 2> compareQueries;
+    glGenQueries(compareQueries.size(), compareQueries.data());
+    auto vplCompared{false};
+    auto vplCompareGatherMs{0.0f}, vplCompareVplMs{0.0f}, vplCompareDifference{0.0f};
 
     while (!glfwWindowShouldClose(window)) {
+        ProgramCache::poll();
+
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
         ImGui::Begin("Control");
-        if (ImGui::SliderFloat3("Light Position", reinterpret_cast<float*>(&lightPos), -35.0f, 35.0f)) {
-            lightIndicator.setPos(lightPos);
+        if (ImGui::SliderInt("Lights", &lightCount, 1, LightList::maxLights)) {
+            selectedLight = std::min(selectedLight, lightCount - 1);
+            selectRsmSize();
         }
+        ImGui::SliderInt("Selected Light", &selectedLight, 0, lightCount - 1);
+        ImGui::SliderFloat3("Light Position", &sceneLights[selectedLight].position[0], -35.0f,
+                            35.0f);
+        ImGui::ColorEdit3("Light Color", &sceneLights[selectedLight].diffuse[0]);
+        if (ImGui::Checkbox("Point Light", &sceneLights[selectedLight].point)) selectRsmSize();
         ImGui::SliderFloat("Reflectivity", reinterpret_cast<float*>(&indirectWeight), 10.0f,
                            100.0f);
+        if (ImGui::Checkbox("Dynamic Resolution", &dynamicResolution) && dynamicResolution) {
+            resolutionController.reset(0);
+            selectQualityLevel(0);
+        }
+        if (dynamicResolution) {
+            ImGui::SliderFloat("Target GPU ms", &resolutionController.targetMs, 4.0f, 50.0f);
+            ImGui::Text("GPU frame: %.2f ms, level %zu of %zu", resolutionController.getAverageMs(),
+                        resolutionController.getLevel() + 1, QUALITY_LEVELS.size());
+            // picked by the controller
+            ImGui::Text("RSM Samples: %u, RSM Resolution: %u, Render Scale: %.0f%%",
+                        SAMPLE_NUM_CHOICES[sampleNumChoice], RSM_SIZE_CHOICES[rsmSizeChoice],
+                        RENDER_SCALE_CHOICES[renderScaleChoice] * 100.0f);
+        } else {
+            if (ImGui::Combo("RSM Samples", &sampleNumChoice,
+                             "16\0" "32\0" "64\0" "128\0" "256\0"))
+                selectVariants();
+            if (ImGui::Combo("RSM Resolution", &rsmSizeChoice, "256\0" "512\0" "1024\0" "2048\0"))
+                selectRsmSize();
+            ImGui::Combo("Render Scale", &renderScaleChoice, "100%\0" "75%\0" "50%\0" "35%\0");
+        }
+        if (ImGui::Combo("Indirect Resolution", &indirectDownsampleChoice,
+                         "Full\0" "1/2\0" "1/4\0"))
+            selectVariants();
+        if (ImGui::Checkbox("Temporal Accumulation", &temporalIndirect)) {
+            indirectTarget.historyValid = false;
+            selectVariants();
+        }
+        if (ImGui::Checkbox("VPL Indirect", &vplIndirect)) selectVariants();
+        if (vplIndirect) ImGui::Text("VPLs: %d", vplLights.count());
+        if (ImGui::Button("Compare VPL with Gather")) vplComparePending = true;
+        if (vplComparePending || vplCompareTiming)
+            ImGui::Text("Comparing...");
+        else if (vplCompared)
+            ImGui::Text("Gather %u: %.2f ms, VPL: %.2f ms, difference %.1f%%", MAX_SAMPLE_NUM,
+                        vplCompareGatherMs, vplCompareVplMs, vplCompareDifference * 100.0f);
+        if (ImGui::Checkbox("Compact RSM", &rsmCompact)) selectRsmLayout(rsmCompact);
+        ImGui::Text("RSM: %u bytes/texel, %u bytes/sample, %.1f MiB",
+                    rsmCompact ? RSM_COMPACT_TEXEL_BYTES : RSM_REFERENCE_TEXEL_BYTES,
+                    rsmCompact ? RSM_COMPACT_SAMPLE_BYTES : RSM_REFERENCE_SAMPLE_BYTES,
+                    (rsmCompact ? RSM_COMPACT_TEXEL_BYTES : RSM_REFERENCE_TEXEL_BYTES) *
+                        rsm.getWidth() * rsm.getHeight() * rsm.getLayers() /
+                        (1024.0f * 1024.0f));
+        for (std::size_t i{0}; i < lightAllocations.size(); i++) {
+            ImGui::Text("  Light %zu: %u px, %u samples", i, lightAllocations[i].rsmSize,
+                        lightAllocations[i].sampleNum);
+        }
+        ImGui::Text("  RSM layers rendered: %d of %u", rsmLayersRendered, rsm.getLayers());
+        ImGui::SliderFloat("LOD Error (px)", &lodPixelError, 0.0f, 8.0f);
+        ImGui::SliderFloat("RSM LOD Error (px)", &rsmLodPixelError, 0.0f, 16.0f);
+        ImGui::Checkbox("Meshlet Culling", &mainModel.meshletCulling);
+        for (auto [name, stats] : {std::pair{"RSM", &rsmStats},
+                                   std::pair{"Indirect", &indirectStats},
+                                   std::pair{"Camera", &cameraStats}}) {
+            ImGui::Text("%s pass: %zu draws, %zu culled, %zu occluded, %zu meshlets culled, "
+                        "%zu triangles",
+                        name, stats->draws, stats->culled, stats->occluded, stats->meshletsCulled,
+                        stats->triangles);
+        }
+        ImGui::Checkbox("Deferred Shading", &deferredShading);
+        ImGui::Checkbox("Occlusion Culling", &occlusionCulling);
+        if (ImGui::Combo("Shadow Filter", &shadowFilter, SHADOW_FILTER_NAMES.data(),
+                         SHADOW_FILTER_NAMES.size()))
+            selectVariants();
+        ImGui::Text("Camera passes: %.2f ms", mainPassMs);
+        for (std::size_t i{0}; i < SHADOW_FILTER_NAMES.size(); i++) {
+            if (shadowFilterMs[i] > 0.0f)
+                ImGui::Text("  %s shadows: %.2f ms", SHADOW_FILTER_NAMES[i], shadowFilterMs[i]);
+        }
         ImGui::End();
         ImGui::Render();
 
@@ -316,40 +770,324 @@ int main() {
 
         processInput(window);
 
-        lightView = glm::lookAt(lightPos, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 cameraProjection =
+            glm::perspective(glm::radians(camera.zoom), 1.f * SCR_WIDTH / SCR_HEIGHT,
+                             cameraNearPlane, cameraFarPlane);
+        glm::mat4 cameraView = camera.getViewMatrix();
+        auto inverseViewProjection{glm::inverse(cameraProjection * cameraView)};
+        const std::array cameraFrustum{Frustum(cameraProjection * cameraView)};
+        // camera values for every pass of this frame
+        FrameConstants::update({cameraProjection, cameraView, inverseViewProjection,
+                                glm::vec4(camera.position, 1.0f)});
+        // what the camera passes test their draws against, if anything
+        auto cameraOcclusion{occlusionCulling ? &occlusion : nullptr};
+        if (cameraOcclusion) cameraOcclusion->beginFrame(cameraProjection * cameraView);
 
-        // rsm render
-        glBindFramebuffer(GL_FRAMEBUFFER, rsmFBO);
-        glViewport(0, 0, RSM_WIDTH, RSM_HEIGHT);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // timings of the frame three before this one, which may change the quality level
+        auto mainPassSlot{mainPassFrames % mainPassQueries.size()};
+        auto mainPassQuery{mainPassQueries[mainPassSlot]};
+        auto& timestamps{frameTimestamps[mainPassSlot]};
+        if (mainPassFrames++ >= mainPassQueries.size() && queryAvailable(mainPassQuery) &&
+            queryAvailable(timestamps[0]) && queryAvailable(timestamps[1])) {
+            GLuint64 elapsed{0};
+            glGetQueryObjectui64v(mainPassQuery, GL_QUERY_RESULT, &elapsed);
+            mainPassMs = elapsed / 1e6f;
+            shadowFilterMs[mainPassFilters[mainPassSlot]] = mainPassMs;
+            GLuint64 start{0}, end{0};
+            glGetQueryObjectui64v(timestamps[0], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(timestamps[1], GL_QUERY_RESULT, &end);
+            frameMs = (end - start) / 1e6f;
+            if (dynamicResolution && resolutionController.update(frameMs))
+                selectQualityLevel(resolutionController.getLevel());
+        }
+        mainPassFilters[mainPassSlot] = shadowFilter;
+        glQueryCounter(timestamps[0], GL_TIMESTAMP);
+
+        // the lights, with their share of the rsm budget of the quality settings
+        LightList::Block lightList{};
+        std::vector<float> contributions;
+        std::vector<int> faceCounts;
+        auto firstLayer{0};
+        for (int i{0}; i < lightCount; i++) {
+            auto& light{lightList.lights[i]};
+            auto position{sceneLights[i].position};
+            if (sceneLights[i].point) {
+                light.faceCount = LightList::cubeFaces;
+                for (int face{0}; face < LightList::cubeFaces; face++) {
+                    auto& [direction, up]{CUBE_FACES[face]};
+                    light.lightSpaceMatrices[face] =
+                        cubeProjection * glm::lookAt(position, position + direction, up);
+                }
+            } else {
+                light.faceCount = 1;
+                light.lightSpaceMatrices[0] =
+                    lightProjection * glm::lookAt(position, glm::vec3(0.0f, 0.0f, 0.0f),
+                                                  glm::vec3(0.0f, 1.0f, 0.0f));
+            }
+            for (int face{0}; face < light.faceCount; face++) {
+                light.inverseLightSpaceMatrices[face] =
+                    glm::inverse(light.lightSpaceMatrices[face]);
+            }
+            light.firstLayer = firstLayer;
+            firstLayer += light.faceCount;
+            contributions.push_back(LightBudget::contribution(
+                inverseViewProjection,
+                std::span(light.lightSpaceMatrices).first(light.faceCount),
+                sceneLights[i].diffuse));
+            faceCounts.push_back(light.faceCount);
+        }
+        lightAllocations = LightBudget::allocate(contributions, faceCounts, lightBudgetSize,
+                                                 SAMPLE_NUM_CHOICES[sampleNumChoice]);
+        for (int i{0}; i < lightCount; i++) {
+            auto& light{lightList.lights[i]};
+            light.position = glm::vec4(sceneLights[i].position, 1.0f);
+            light.diffuse = glm::vec4(sceneLights[i].diffuse, 1.0f);
+            light.rsmScale = glm::vec2(static_cast<float>(lightAllocations[i].rsmSize) /
+                                       rsm.getWidth());
+            light.rsmSampleShare = static_cast<float>(lightAllocations[i].sampleNum) /
+                                   SAMPLE_NUM_CHOICES[sampleNumChoice];
+        }
+        lightList.lightCount = lightCount;
+        LightList::update(lightList);
+
+        auto renderScale{RENDER_SCALE_CHOICES[renderScaleChoice]};
+        auto renderWidth{std::max(static_cast<unsigned>(SCR_WIDTH * renderScale), 1u)};
+        auto renderHeight{std::max(static_cast<unsigned>(SCR_HEIGHT * renderScale), 1u)};
+        // camera passes end up in the window directly at full scale, unless occlusion culling
+        // reads their depth
+        auto sceneFbo{0u};
+        if (renderScale < 1.0f || occlusionCulling) {
+            sceneTarget.resize(renderWidth, renderHeight);
+            sceneFbo = sceneTarget.fbo;
+        }
 
+        // rsm render, per light into the lower left of its layers, every face in one pass
+        // through the layered framebuffers: static casters only when the light moved or its
+        // size changed, then the animated model on top of their copy. A light the model is not
+        // in, and was not in last time, still has valid layers and is skipped.
         lightSpaceShader.use();
-        lightSpaceShader.setUniform("lightSpaceMatrix", lightProjection * lightView);
-        lightSpaceShader.setUniform("light.position", lightPos);
-        glViewport(0, 0, RSM_WIDTH, RSM_HEIGHT);
-        planes.draw(lightSpaceShader);
-        mainModel.draw(lightSpaceShader);
+        auto modelBounds{mainModel.bounds()};
+        rsmLayersRendered = 0;
+        rsmStats = {};
+        for (int i{0}; i < lightCount; i++) {
+            auto& layer{rsmLayers[i]};
+            const auto& light{lightList.lights[i]};
+            std::vector<Frustum> lightFrustums;
+            for (int face{0}; face < light.faceCount; face++)
+                lightFrustums.emplace_back(light.lightSpaceMatrices[face]);
+            auto size{lightAllocations[i].rsmSize};
+            lightSpaceShader.setUniform("rsmLight", i);
+            glViewport(0, 0, size, size);
+            auto staticChanged{!layer.staticValid ||
+                               light.lightSpaceMatrices != layer.lightSpaces || size != layer.size};
+            if (staticChanged) {
+                // a clear of the layered framebuffer would wipe every light's layers
+                for (int face{0}; face < light.faceCount; face++) {
+                    glBindFramebuffer(GL_FRAMEBUFFER,
+                                      staticRsm.framebuffer(rsmCompact, light.firstLayer + face));
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                }
+                // the geometry shader projects, the view projection of the draw is unused
+                glBindFramebuffer(GL_FRAMEBUFFER, staticRsm.layeredFramebuffer(rsmCompact));
+                rsmStats += planes.draw(lightSpaceShader.current(), glm::mat4(1.0f), lightFrustums);
+                layer.lightSpaces = light.lightSpaceMatrices;
+                layer.size = size;
+                // drawn by a stand-in while the selected variant compiles, redo it once that is
+                // done
+                layer.staticValid = lightSpaceShader.current().ready();
+            }
+            auto modelVisible{std::ranges::any_of(lightFrustums, [&](const Frustum& frustum) {
+                return frustum.intersects(glm::vec3(modelBounds), modelBounds.w);
+            })};
+            if (!staticChanged && !modelVisible && !layer.modelDrawn) continue;
+            for (int face{0}; face < light.faceCount; face++)
+                staticRsm.copyTo(rsm, rsmCompact, light.firstLayer + face);
+            if (modelVisible) {
+                glBindFramebuffer(GL_FRAMEBUFFER, rsm.layeredFramebuffer(rsmCompact));
+                rsmStats += mainModel.draw(
+                    lightSpaceShader.current(), glm::mat4(1.0f),
+                    LodView(sceneLights[i].position, static_cast<float>(size),
+                            sceneLights[i].point ? cubeFovy : spotFovy, rsmLodPixelError),
+                    lightFrustums);
+            }
+            layer.modelDrawn = modelVisible;
+            rsmLayersRendered += light.faceCount;
+        }
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        // virtual point lights of this rsm; the ones the gathers get are a frame or two older
+        if (vplIndirect || vplComparePending) {
+            glBindFramebuffer(GL_FRAMEBUFFER, vplLights.fbo);
+            glViewport(0, 0, VplLights::GRID,
+                       VplLights::GRID * LightList::maxLights * LightList::cubeFaces);
+            glDisable(GL_DEPTH_TEST);
+            vplExtractShader.use();
+            glBindVertexArray(fullscreenVao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glEnable(GL_DEPTH_TEST);
+            vplLights.capture();
+            vplLights.update();
+        }
+
+        // geometry of the camera view into the indirect targets, at their current size
+        auto drawIndirectGeometry{[&] {
+            glBindFramebuffer(GL_FRAMEBUFFER, indirectTarget.geometryFbo);
+            glViewport(0, 0, indirectTarget.getWidth(), indirectTarget.getHeight());
+            // zero distance marks texels nothing was drawn to
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            geometryShader.use();
+            indirectStats = planes.draw(geometryShader, cameraProjection * cameraView,
+                                        cameraFrustum, cameraOcclusion);
+            indirectStats += mainModel.draw(
+                geometryShader, cameraProjection * cameraView,
+                LodView(camera.position, static_cast<float>(indirectTarget.getHeight()),
+                        glm::radians(camera.zoom), lodPixelError),
+                cameraFrustum, cameraOcclusion);
+        }};
+
+        // the comparison: indirect light of both gathers at render resolution, each timed on
+        // its own and read back, the difference relative to the mean of the full gather
+        if (vplComparePending && !vplCompareTiming) {
+            auto gatherVariant{indirectVariant(MAX_SAMPLE_NUM, rsmCompact, false, false)};
+            auto vplVariant{indirectVariant(MAX_SAMPLE_NUM, rsmCompact, false, true)};
+            if (indirectShader.prepare(gatherVariant).ready() &&
+                indirectShader.prepare(vplVariant).ready() && vplLights.ready()) {
+                indirectTarget.resize(renderWidth, renderHeight);
+                drawIndirectGeometry();
+                glBindFramebuffer(GL_FRAMEBUFFER, indirectTarget.indirectFbo);
+                glDisable(GL_DEPTH_TEST);
+                glBindVertexArray(fullscreenVao);
+                std::array<std::vector<float>, 2> images;
+                for (std::size_t i{0}; i < images.size(); i++) {
+                    indirectShader.select(i ? vplVariant : gatherVariant);
+                    glBeginQuery(GL_TIME_ELAPSED, compareQueries[i]);
+                    glDrawArrays(GL_TRIANGLES, 0, 3);
+                    glEndQuery(GL_TIME_ELAPSED);
+                    images[i].resize(renderWidth * renderHeight * 3);
+                    glReadPixels(0, 0, renderWidth, renderHeight, GL_RGB, GL_FLOAT,
+                                 images[i].data());
+                }
+                glBindVertexArray(0);
+                glEnable(GL_DEPTH_TEST);
+                auto squaredError{0.0}, mean{0.0};
+                for (std::size_t i{0}; i < images[0].size(); i++) {
+                    auto difference{images[1][i] - images[0][i]};
+                    squaredError += difference * difference / images[0].size();
+                    mean += images[0][i] / images[0].size();
+                }
+                vplCompareDifference = mean > 0.0 ? std::sqrt(squaredError) / mean : 0.0;
+                vplComparePending = false;
+                vplCompareTiming = true;
+                selectVariants();
+            }
+        }
+        if (vplCompareTiming && std::ranges::all_of(compareQueries, queryAvailable)) {
+            GLuint64 gather{0}, vpl{0};
+            glGetQueryObjectui64v(compareQueries[0], GL_QUERY_RESULT, &gather);
+            glGetQueryObjectui64v(compareQueries[1], GL_QUERY_RESULT, &vpl);
+            vplCompareGatherMs = gather / 1e6f;
+            vplCompareVplMs = vpl / 1e6f;
+            vplCompareTiming = false;
+            vplCompared = true;
+        }
+
+        glBeginQuery(GL_TIME_ELAPSED, mainPassQuery);
+
+        // low resolution or accumulated indirect light
+        if (auto divisor{INDIRECT_DOWNSAMPLE_CHOICES[indirectDownsampleChoice]};
+            divisor > 1 || temporalIndirect) {
+            indirectTarget.resize(renderWidth / divisor, renderHeight / divisor);
+            drawIndirectGeometry();
+
+            glBindFramebuffer(GL_FRAMEBUFFER, indirectTarget.indirectFbo);
+            glDisable(GL_DEPTH_TEST);
+            indirectShader.use();
+            indirectShader.setUniform("rsmFrame",
+                                      static_cast<int>(temporalFrame++ % TEMPORAL_FRAMES));
+            glBindVertexArray(fullscreenVao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            glActiveTexture(GL_TEXTURE7);
+            if (temporalIndirect) {
+                indirectTarget.swapHistory();
+                auto current{indirectTarget.currentHistory()};
+                glActiveTexture(GL_TEXTURE12);
+                glBindTexture(GL_TEXTURE_2D,
+                              indirectTarget.historyMap[indirectTarget.previousHistory()]);
+                glBindFramebuffer(GL_FRAMEBUFFER, indirectTarget.historyFbo[current]);
+                temporalShader.use();
+                temporalShader.setUniform("previousViewProjection", previousViewProjection);
+                temporalShader.setUniform("previousViewPos", previousViewPos);
+                temporalShader.setUniform("historyValid", indirectTarget.historyValid);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                indirectTarget.historyValid = true;
+                glActiveTexture(GL_TEXTURE7);
+                glBindTexture(GL_TEXTURE_2D, indirectTarget.historyMap[current]);
+            } else {
+                glBindTexture(GL_TEXTURE_2D, indirectTarget.indirectMap);
+            }
+            glBindVertexArray(0);
+            glEnable(GL_DEPTH_TEST);
+        }
+        previousViewProjection = cameraProjection * cameraView;
+        previousViewPos = camera.position;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+        glViewport(0, 0, renderWidth, renderHeight);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        mainShader.use();
-        mainShader.setUniform("indirectWeight", indirectWeight);
-        mainShader.setUniform("viewPos", camera.position);
-        glm::mat4 cameraProjection =
-            glm::perspective(glm::radians(camera.zoom), 1.f * SCR_WIDTH / SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 cameraView = camera.getViewMatrix();
-        mainShader.setUniform("projection", cameraProjection);
-        mainShader.setUniform("view", cameraView);
-        mainShader.setUniform("light.position", lightPos);
-        mainShader.setUniform("lightSpaceMatrix", lightProjection * lightView);
-        planes.draw(mainShader);
-        mainModel.draw(mainShader);
+        LodView cameraLod(camera.position, static_cast<float>(renderHeight),
+                          glm::radians(camera.zoom), lodPixelError);
+        if (deferredShading) {
+            gbuffer.resize(renderWidth, renderHeight);
+            glBindFramebuffer(GL_FRAMEBUFFER, gbuffer.fbo);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            gbufferShader.use();
+            cameraStats = planes.draw(gbufferShader, cameraProjection * cameraView, cameraFrustum,
+                                      cameraOcclusion);
+            cameraStats += mainModel.draw(gbufferShader, cameraProjection * cameraView, cameraLod,
+                                          cameraFrustum, cameraOcclusion);
+
+            // writes the g-buffer depth, so the test has to pass everywhere
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+            glDepthFunc(GL_ALWAYS);
+            deferredShader.use();
+            deferredShader.setUniform("indirectWeight", indirectWeight);
+            glBindVertexArray(fullscreenVao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS);
+        } else {
+            mainShader.use();
+            mainShader.setUniform("indirectWeight", indirectWeight);
+            cameraStats = planes.draw(mainShader.current(), cameraProjection * cameraView,
+                                      cameraFrustum, cameraOcclusion);
+            cameraStats += mainModel.draw(mainShader.current(), cameraProjection * cameraView,
+                                          cameraLod, cameraFrustum, cameraOcclusion);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+
+        // borderline draws checked against this frame's depth, which then becomes the pyramid
+        // of a later frame
+        if (cameraOcclusion) {
+            cameraOcclusion->confirm(occlusionBoxShader);
+            cameraOcclusion->capture(hiZReduceShader, fullscreenVao, sceneTarget.depthMap,
+                                     renderWidth, renderHeight);
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+            glViewport(0, 0, renderWidth, renderHeight);
+        }
 
         lightIndicator.setMvp(cameraProjection * cameraView);
-        lightIndicator.draw();
+        for (int i{0}; i < lightCount; i++) {
+            lightIndicator.setPos(sceneLights[i].position);
+            lightIndicator.draw();
+        }
+
+        if (sceneFbo) sceneTarget.present(SCR_WIDTH, SCR_HEIGHT);
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        glQueryCounter(timestamps[1], GL_TIMESTAMP);
 
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
@@ -422,22 +1160,26 @@ static void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 }
 
 GLuint createRandomTexture(std::size_t size) {
-    static std::default_random_engine eng(std::random_device{}());
-    static std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-    std::vector<glm::vec3> randomData(size);
-    for (auto& i : randomData) {
-        float r1 = dist(eng);
-        float r2 = dist(eng);
-        i = {r1 * std::sin(2 * std::numbers::pi * r2), r1 * std::cos(2 * std::numbers::pi * r2),
-             r1 * r1};
-    }
+    auto offsets{rsmSampleOffsets(size, SAMPLE_SEED)};
     GLuint randomTexture;
     glGenTextures(1, &randomTexture);
     glBindTexture(GL_TEXTURE_2D, randomTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, size, 1, 0, GL_RGB, GL_FLOAT, randomData.data());
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, size, 1, 0, GL_RGB, GL_FLOAT, offsets.data());
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     return randomTexture;
-}
\ No newline at end of file
+}
+
+GLuint createBlueNoiseTexture(int size) {
+    auto noise{blueNoise(size, SAMPLE_SEED)};
+    GLuint noiseTexture;
+    glGenTextures(1, &noiseTexture);
+    glBindTexture(GL_TEXTURE_2D, noiseTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, noise.data());
+    // read with texelFetch, tiled over the screen
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return noiseTexture;
+}
@@ -9,77 +9,55 @@
 #include <glad/glad.h>  // holds all OpenGL type declarations
 
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
 
-#include "shader.h"
+#include "aabb.hpp"
 
-#include <string>
 #include <vector>
-#include <fstream>
 
 struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
 };
 
-class Mesh {
-public:
-    // mesh data
-    std::vector<Vertex> vertices;
-    std::vector<GLuint> indices;
-    GLuint vao;
-
-    Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices)
-        : vertices(vertices), indices(indices) {
-        // now that we have all the required data, set the vertex buffers and its attribute
-        // pointers.
-        setupMesh();
-    }
-
-    // render the mesh
-    void draw(Shader& shader) const {
-        // draw mesh
-        glBindVertexArray(vao);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+// A cluster of triangles of a level of detail, see meshlet_builder.h: its range in the index
+// buffer, within that of the level, and its bounds in model space.
+struct Meshlet {
+    GLuint firstIndex;
+    GLsizei indexCount;
+    // radius in w
+    glm::vec4 sphere{0.0f};
+    // normal cone: the axis, and in w the sine of its half angle; 1 for one that is never culled
+    glm::vec4 cone{0.0f, 0.0f, 0.0f, 1.0f};
+
+    // whether every triangle faces away from `eye`, in model space: the direction to any point
+    // of the sphere is within 90 degrees less the half angle of the axis
+    bool backFacing(const glm::vec3& eye) const {
+        auto toCenter{glm::vec3(sphere) - eye};
+        return glm::dot(toCenter, glm::vec3(cone)) >=
+               cone.w * glm::length(toCenter) + sphere.w * (1.0f + cone.w);
     }
+};
 
-private:
-    // render data
-    GLuint vbo, ebo;
-
-    // initializes all the buffer objects/arrays
-    void setupMesh() {
-        // create buffers/arrays
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
-
-        glBindVertexArray(vao);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly
-        // to a glm::vec3/2 array which again translates to 3/2 floats which translates to a byte
-        // array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(),
-                     GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(),
-                     GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                              reinterpret_cast<void*>(offsetof(Vertex, position)));
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                              reinterpret_cast<void*>(offsetof(Vertex, normal)));
-
-        glBindVertexArray(0);
-    }
+// A submesh of a model: its range in the vertex and index buffers of the MeshPool it lives in.
+// Indices are local to the mesh, baseVertex is added to them when drawing. Every level of detail
+// indexes the same vertices.
+struct Mesh {
+    // a level of detail: its index range, split into meshlets, and how far it is from the full
+    // mesh, in model units
+    struct Lod {
+        GLuint firstIndex;
+        GLsizei indexCount;
+        float error;
+        std::vector<Meshlet> meshlets{};
+    };
+
+    GLint baseVertex;
+    GLsizei vertexCount;
+    // finest first, the first one is the mesh as loaded
+    std::vector<Lod> lods;
+    // bounds in model space, set by MeshPool::upload: a box, and a sphere with the radius in w
+    Aabb box;
+    glm::vec4 sphere{0.0f};
 };
-#endif
\ No newline at end of file
+
+#endif
@@ -0,0 +1,198 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include <glad/glad.h>
+
+#include "mesh.hpp"
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+// what draws of a pass submitted, and how many meshes were culled, outside the frusta or
+// occluded, and how many meshlets of the meshes drawn
+struct DrawStats {
+    std::size_t draws{0};
+    std::size_t culled{0};
+    std::size_t occluded{0};
+    std::size_t meshletsCulled{0};
+    std::size_t triangles{0};
+
+    DrawStats& operator+=(const DrawStats& other) {
+        draws += other.draws;
+        culled += other.culled;
+        occluded += other.occluded;
+        meshletsCulled += other.meshletsCulled;
+        triangles += other.triangles;
+        return *this;
+    }
+};
+
+// Every mesh of a model in one VBO and one EBO behind a single VAO, each drawn from its range
+// with a base vertex. Meshes are written in place into the CPU arrays by add(), their coarser
+// levels of detail appended by addLod(); upload() splits every level into meshlets, moves them
+// to the GPU and frees the arrays unless asked to retain them.
+class MeshPool {
+public:
+    // the vertices and indices of a mesh added to the pool, to fill in
+    struct Staging {
+        std::span<Vertex> vertices;
+        std::span<GLuint> indices;
+    };
+
+    MeshPool() : vao{0}, vbo{0}, ebo{0} {}
+    MeshPool(const MeshPool&) = delete;
+
+    ~MeshPool() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+    }
+
+    // appends a mesh of `vertexCount` vertices and `indexCount` indices, local to the mesh; the
+    // spans are valid until the next add()
+    Staging add(std::size_t vertexCount, std::size_t indexCount) {
+        auto baseVertex{vertices.size()}, firstIndex{indices.size()};
+        vertices.resize(baseVertex + vertexCount);
+        indices.resize(firstIndex + indexCount);
+        meshes.push_back({static_cast<GLint>(baseVertex), static_cast<GLsizei>(vertexCount),
+                          {{static_cast<GLuint>(firstIndex), static_cast<GLsizei>(indexCount),
+                            0.0f}}});
+        return {std::span(vertices).subspan(baseVertex, vertexCount),
+                std::span(indices).subspan(firstIndex, indexCount)};
+    }
+
+    // appends a level of detail of `error` to the last mesh added, coarser than its others
+    void addLod(std::span<const GLuint> lodIndices, float error) {
+        auto firstIndex{indices.size()};
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        meshes.back().lods.push_back({static_cast<GLuint>(firstIndex),
+                                      static_cast<GLsizei>(lodIndices.size()), error});
+    }
+
+    // creates the buffers from the CPU arrays, which are released unless `retain`
+    void upload(bool retain = false) {
+        for (auto& mesh : meshes) {
+            auto meshVertices{std::span(vertices).subspan(mesh.baseVertex, mesh.vertexCount)};
+            // meshlets of each level, which reorders its indices
+            for (auto& lod : mesh.lods) {
+                lod.meshlets = buildMeshlets(
+                    meshVertices, std::span(indices).subspan(lod.firstIndex, lod.indexCount));
+                for (auto& meshlet : lod.meshlets) meshlet.firstIndex += lod.firstIndex;
+            }
+            // bounds, the sphere around the center of the box
+            if (meshVertices.empty()) continue;
+            for (const auto& vertex : meshVertices) mesh.box.add(vertex.position);
+            auto center{mesh.box.center()};
+            auto radius{0.0f};
+            for (const auto& vertex : meshVertices)
+                radius = std::max(radius, glm::length(vertex.position - center));
+            mesh.sphere = glm::vec4(center, radius);
+        }
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(),
+                     GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(),
+                     GL_STATIC_DRAW);
+
+        // vertex positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              reinterpret_cast<void*>(offsetof(Vertex, position)));
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              reinterpret_cast<void*>(offsetof(Vertex, normal)));
+        glBindVertexArray(0);
+
+        if (!retain) {
+            std::vector<Vertex>{}.swap(vertices);
+            std::vector<GLuint>{}.swap(indices);
+        }
+    }
+
+    // draws every mesh of the pool at the level of detail `level(mesh)` picks, none where it
+    // gives nullopt (counted as culled), and of that level the meshlets `keep(meshlet)` accepts.
+    // The meshlets kept are compacted into a list of index ranges, those next to each other
+    // merged, that goes out in a single multi-draw.
+    template <typename LevelOf, typename KeepMeshlet>
+    DrawStats draw(LevelOf&& level, KeepMeshlet&& keep) {
+        DrawStats stats;
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        for (const auto& mesh : meshes) {
+            auto picked{level(mesh)};
+            if (!picked) {
+                stats.culled++;
+                continue;
+            }
+            const auto& lod{mesh.lods[std::min(*picked, mesh.lods.size() - 1)]};
+            // where the last range of this mesh ends, none yet
+            auto end{std::numeric_limits<GLuint>::max()};
+            for (const auto& meshlet : lod.meshlets) {
+                if (!keep(meshlet)) {
+                    stats.meshletsCulled++;
+                    continue;
+                }
+                if (meshlet.firstIndex == end) {
+                    counts.back() += meshlet.indexCount;
+                } else {
+                    counts.push_back(meshlet.indexCount);
+                    offsets.push_back(reinterpret_cast<const void*>(
+                        static_cast<std::size_t>(meshlet.firstIndex) * sizeof(GLuint)));
+                    baseVertices.push_back(mesh.baseVertex);
+                }
+                end = meshlet.firstIndex + meshlet.indexCount;
+                stats.triangles += meshlet.indexCount / 3;
+            }
+        }
+        stats.draws = counts.size();
+        if (counts.empty()) return stats;
+        glBindVertexArray(vao);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT,
+                                      offsets.data(), static_cast<GLsizei>(counts.size()),
+                                      baseVertices.data());
+        glBindVertexArray(0);
+        return stats;
+    }
+
+    const std::vector<Mesh>& getMeshes() const {
+        return meshes;
+    }
+    // the CPU arrays; empty after an upload that did not retain them
+    const std::vector<Vertex>& getVertices() const {
+        return vertices;
+    }
+    const std::vector<GLuint>& getIndices() const {
+        return indices;
+    }
+
+private:
+    GLuint vao, vbo, ebo;
+    std::vector<Mesh> meshes;
+    std::vector<Vertex> vertices;
+    std::vector<GLuint> indices;
+    // the draw list of the last draw(), kept to reuse its storage
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+};
+
+#endif
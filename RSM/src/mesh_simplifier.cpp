@@ -0,0 +1,259 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+// a normal turned all the way round costs as much as moving by this share of the edge length
+constexpr double NORMAL_WEIGHT{0.5};
+// planes along open borders weigh this much more than a face of the same size
+constexpr double BORDER_WEIGHT{10.0};
+// a collapse may turn a remaining triangle until the cosine of the angle drops below this
+constexpr double MIN_NORMAL_COSINE{0.25};
+// each pass collapses independent edges only, so it takes a few to get to the target
+constexpr int MAX_PASSES{32};
+
+// weighted squared distances to a set of planes, p^T Q p for p = (x, y, z, 1)
+struct Quadric {
+    // upper triangle of the symmetric 4x4 matrix, row by row
+    std::array<double, 10> q{};
+    // sum of the weights, to turn the sum into a mean
+    double weight{0.0};
+
+    // the plane through `point` with unit `normal`
+    static Quadric plane(const glm::dvec3& normal, const glm::dvec3& point, double w) {
+        auto a{normal.x}, b{normal.y}, c{normal.z}, d{-glm::dot(normal, point)};
+        Quadric result;
+        result.q = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+        for (auto& value : result.q) value *= w;
+        result.weight = w;
+        return result;
+    }
+
+    Quadric& operator+=(const Quadric& other) {
+        for (std::size_t i{0}; i < q.size(); i++) q[i] += other.q[i];
+        weight += other.weight;
+        return *this;
+    }
+
+    // mean squared distance of `p` to the planes
+    double error(const glm::dvec3& p) const {
+        if (weight <= 0.0) return 0.0;
+        auto x{p.x}, y{p.y}, z{p.z};
+        auto sum{q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x +
+                 q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y + q[7] * z * z +
+                 2.0 * q[8] * z + q[9]};
+        return std::max(sum, 0.0) / weight;
+    }
+};
+
+struct PositionHash {
+    std::size_t operator()(const glm::vec3& p) const {
+        std::array<std::uint32_t, 3> bits;
+        std::memcpy(bits.data(), &p[0], sizeof(bits));
+        return bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+    }
+};
+
+struct Collapse {
+    double cost;
+    std::uint32_t from, to;
+};
+
+}  // namespace
+
+std::vector<GLuint> simplifyMesh(std::span<const Vertex> vertices,
+                                 std::span<const GLuint> indices, std::size_t targetIndexCount,
+                                 float& error) {
+    error = 0.0f;
+    // weld by position: the topology is that of the positions, the copies of one are its wedges
+    std::vector<std::uint32_t> remap(vertices.size());
+    std::vector<glm::dvec3> positions;
+    std::vector<std::vector<std::uint32_t>> wedges;
+    {
+        std::unordered_map<glm::vec3, std::uint32_t, PositionHash> ids;
+        for (std::size_t v{0}; v < vertices.size(); v++) {
+            // -0 and 0 weld too
+            auto [it, inserted]{ids.try_emplace(vertices[v].position + 0.0f,
+                                                static_cast<std::uint32_t>(positions.size()))};
+            if (inserted) {
+                positions.emplace_back(vertices[v].position);
+                wedges.emplace_back();
+            }
+            remap[v] = it->second;
+            wedges[it->second].push_back(static_cast<std::uint32_t>(v));
+        }
+    }
+    auto corner{[&](const std::vector<GLuint>& list, std::size_t i) { return remap[list[i]]; }};
+
+    std::vector<GLuint> result(indices.begin(), indices.end());
+
+    // quadrics of the input surface, accumulated by the collapses so errors stay relative to it
+    std::vector<Quadric> quadrics(positions.size());
+    {
+        // the triangle of each edge seen once, by ordered position pair
+        std::unordered_map<std::uint64_t, int> edgeUses;
+        auto edgeKey{[](std::uint32_t a, std::uint32_t b) {
+            return static_cast<std::uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+        }};
+        for (std::size_t t{0}; t < result.size(); t += 3) {
+            for (int e{0}; e < 3; e++) {
+                edgeUses[edgeKey(corner(result, t + e), corner(result, t + (e + 1) % 3))]++;
+            }
+        }
+        for (std::size_t t{0}; t < result.size(); t += 3) {
+            std::array p{positions[corner(result, t)], positions[corner(result, t + 1)],
+                         positions[corner(result, t + 2)]};
+            auto normal{glm::cross(p[1] - p[0], p[2] - p[0])};
+            auto doubleArea{glm::length(normal)};
+            if (doubleArea <= 0.0) continue;
+            normal /= doubleArea;
+            auto face{Quadric::plane(normal, p[0], doubleArea * 0.5)};
+            for (int c{0}; c < 3; c++) quadrics[corner(result, t + c)] += face;
+            // a border edge: a plane through it, upright on the face
+            for (int e{0}; e < 3; e++) {
+                auto a{corner(result, t + e)}, b{corner(result, t + (e + 1) % 3)};
+                if (edgeUses[edgeKey(a, b)] != 1) continue;
+                auto edge{p[(e + 1) % 3] - p[e]};
+                auto length2{glm::dot(edge, edge)};
+                if (length2 <= 0.0) continue;
+                auto border{Quadric::plane(glm::normalize(glm::cross(edge, normal)), p[e],
+                                           BORDER_WEIGHT * length2)};
+                quadrics[a] += border;
+                quadrics[b] += border;
+            }
+        }
+    }
+
+    // the wedge of position `to` with the closest normal to `wedge`, and the cosine between them
+    auto wedgeTarget{[&](std::uint32_t wedge, std::uint32_t to) {
+        auto best{wedges[to].front()};
+        auto bestCosine{-2.0f};
+        for (auto candidate : wedges[to]) {
+            auto cosine{glm::dot(vertices[wedge].normal, vertices[candidate].normal)};
+            if (cosine > bestCosine) {
+                best = candidate;
+                bestCosine = cosine;
+            }
+        }
+        return std::pair{best, bestCosine};
+    }};
+    // squared distance, in model units, that moving position `from` onto `to` costs
+    auto collapseCost{[&](std::uint32_t from, std::uint32_t to) {
+        auto quadric{quadrics[from]};
+        quadric += quadrics[to];
+        auto turn{0.0};
+        for (auto wedge : wedges[from])
+            turn = std::max(turn, 1.0 - static_cast<double>(wedgeTarget(wedge, to).second));
+        auto edge{positions[to] - positions[from]};
+        return quadric.error(positions[to]) + NORMAL_WEIGHT * turn * glm::dot(edge, edge);
+    }};
+
+    std::vector<std::uint32_t> collapsed(positions.size());
+    std::vector<std::uint32_t> vertexTarget(vertices.size());
+    std::vector<char> locked(positions.size());
+    std::vector<std::uint32_t> triangleStart, triangleList;
+    for (int pass{0}; pass < MAX_PASSES && result.size() > targetIndexCount; pass++) {
+        auto triangleCount{result.size() / 3};
+        // triangles around each position
+        triangleStart.assign(positions.size() + 1, 0);
+        for (std::size_t i{0}; i < result.size(); i++) triangleStart[corner(result, i) + 1]++;
+        for (std::size_t p{0}; p < positions.size(); p++) triangleStart[p + 1] += triangleStart[p];
+        triangleList.resize(result.size());
+        {
+            auto fill{triangleStart};
+            for (std::size_t i{0}; i < result.size(); i++)
+                triangleList[fill[corner(result, i)]++] = static_cast<std::uint32_t>(i / 3);
+        }
+
+        // every edge once, in the cheaper direction, cheapest first
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+        edges.reserve(result.size());
+        for (std::size_t t{0}; t < result.size(); t += 3) {
+            for (int e{0}; e < 3; e++) {
+                auto a{corner(result, t + e)}, b{corner(result, t + (e + 1) % 3)};
+                if (a != b) edges.emplace_back(std::min(a, b), std::max(a, b));
+            }
+        }
+        std::ranges::sort(edges);
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        std::vector<Collapse> collapses;
+        collapses.reserve(edges.size());
+        for (auto [a, b] : edges) {
+            auto forward{collapseCost(a, b)}, backward{collapseCost(b, a)};
+            collapses.push_back(forward <= backward ? Collapse{forward, a, b}
+                                                    : Collapse{backward, b, a});
+        }
+        std::ranges::sort(collapses, {}, &Collapse::cost);
+
+        // collapses that share no triangle, so each one's cost is still what was computed
+        std::iota(collapsed.begin(), collapsed.end(), 0u);
+        std::ranges::fill(locked, 0);
+        auto applied{0};
+        for (const auto& [cost, from, to] : collapses) {
+            if (triangleCount * 3 <= targetIndexCount) break;
+            if (locked[from] || locked[to]) continue;
+            // triangles that vanish, and none of the others folded over
+            auto removed{0uz};
+            auto valid{true};
+            for (auto i{triangleStart[from]}; i < triangleStart[from + 1] && valid; i++) {
+                auto t{triangleList[i] * 3uz};
+                std::array c{corner(result, t), corner(result, t + 1), corner(result, t + 2)};
+                if (std::ranges::find(c, to) != c.end()) {
+                    removed++;
+                    continue;
+                }
+                std::array p{positions[c[0]], positions[c[1]], positions[c[2]]};
+                auto before{glm::cross(p[1] - p[0], p[2] - p[0])};
+                for (int k{0}; k < 3; k++) {
+                    if (c[k] == from) p[k] = positions[to];
+                }
+                auto after{glm::cross(p[1] - p[0], p[2] - p[0])};
+                valid = glm::dot(before, after) >
+                        MIN_NORMAL_COSINE * glm::length(before) * glm::length(after);
+            }
+            if (!valid) continue;
+
+            collapsed[from] = to;
+            for (auto wedge : wedges[from]) vertexTarget[wedge] = wedgeTarget(wedge, to).first;
+            quadrics[to] += quadrics[from];
+            error = std::max(error, static_cast<float>(std::sqrt(cost)));
+            triangleCount -= removed;
+            applied++;
+            locked[from] = locked[to] = 1;
+            for (auto i{triangleStart[from]}; i < triangleStart[from + 1]; i++) {
+                for (int c{0}; c < 3; c++) locked[corner(result, triangleList[i] * 3uz + c)] = 1;
+            }
+        }
+        if (!applied) break;
+
+        // the triangles with every collapse of the pass applied, less the degenerate ones
+        std::vector<GLuint> next;
+        next.reserve(triangleCount * 3);
+        for (std::size_t t{0}; t < result.size(); t += 3) {
+            std::array<GLuint, 3> triangle;
+            std::array<std::uint32_t, 3> c;
+            for (int i{0}; i < 3; i++) {
+                auto v{result[t + i]};
+                auto moved{collapsed[remap[v]] != remap[v]};
+                triangle[i] = moved ? vertexTarget[v] : v;
+                c[i] = remap[triangle[i]];
+            }
+            if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0]) continue;
+            next.insert(next.end(), triangle.begin(), triangle.end());
+        }
+        result = std::move(next);
+    }
+    return result;
+}
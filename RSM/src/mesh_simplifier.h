@@ -0,0 +1,29 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "mesh.hpp"
+
+// Quadric edge collapse (Garland and Heckbert) of the triangle list `indices` over `vertices`
+// down to about `targetIndexCount` indices, for a coarser level of detail. Returns indices into
+// the same vertices and sets `error` to the largest distance of the result from the input
+// surface, in model units.
+//
+// Vertices are welded by position for the topology, so the copies along a normal seam move
+// together. A collapse moves a vertex onto a neighbour, each copy onto the neighbour's copy of
+// the closest normal; its cost adds the normal change to the quadric error, so shading is kept
+// where the shape alone would allow a collapse. Open borders are held by extra planes, and a
+// collapse that would fold a triangle over is skipped.
+std::vector<GLuint> simplifyMesh(std::span<const Vertex> vertices,
+                                 std::span<const GLuint> indices, std::size_t targetIndexCount,
+                                 float& error);
+
+#endif
@@ -0,0 +1,182 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#include "meshlet_builder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
+namespace {
+
+constexpr std::size_t MAX_VERTICES{64};
+constexpr std::size_t MAX_TRIANGLES{124};
+// a triangle facing the opposite way of the meshlet costs as much as this many new vertices
+constexpr float CONE_WEIGHT{0.25f};
+// below this cosine between the axis and some normal, the cone is too wide to ever cull
+constexpr float MIN_CONE_COSINE{0.1f};
+
+struct PositionHash {
+    std::size_t operator()(const glm::vec3& p) const {
+        std::array<std::uint32_t, 3> bits;
+        std::memcpy(bits.data(), &p[0], sizeof(bits));
+        return bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u;
+    }
+};
+
+// 1 if the triangles, welded by position, are closed with every edge used once each way and
+// wound counterclockwise seen from outside, -1 if wound the other way, 0 if not closed
+float orientation(std::span<const Vertex> vertices, std::span<const GLuint> indices) {
+    std::vector<std::uint32_t> remap(vertices.size());
+    {
+        std::unordered_map<glm::vec3, std::uint32_t, PositionHash> ids;
+        for (std::size_t v{0}; v < vertices.size(); v++) {
+            // -0 and 0 weld too
+            remap[v] = ids.try_emplace(vertices[v].position + 0.0f,
+                                       static_cast<std::uint32_t>(ids.size()))
+                           .first->second;
+        }
+    }
+    std::unordered_map<std::uint64_t, int> edges;
+    auto edgeKey{[](std::uint32_t a, std::uint32_t b) {
+        return static_cast<std::uint64_t>(a) << 32 | b;
+    }};
+    auto volume{0.0};
+    for (std::size_t t{0}; t < indices.size(); t += 3) {
+        std::array corners{remap[indices[t]], remap[indices[t + 1]], remap[indices[t + 2]]};
+        // collapsed by the weld: its edges there and back cancel out
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+            continue;
+        for (int e{0}; e < 3; e++) edges[edgeKey(corners[e], corners[(e + 1) % 3])]++;
+        glm::dvec3 a{vertices[indices[t]].position}, b{vertices[indices[t + 1]].position},
+            c{vertices[indices[t + 2]].position};
+        volume += glm::dot(a, glm::cross(b, c));
+    }
+    for (auto [key, uses] : edges) {
+        auto opposite{edges.find(key << 32 | key >> 32)};
+        if (uses != 1 || opposite == edges.end() || opposite->second != 1) return 0.0f;
+    }
+    return volume > 0.0 ? 1.0f : volume < 0.0 ? -1.0f : 0.0f;
+}
+
+}  // namespace
+
+std::vector<Meshlet> buildMeshlets(std::span<const Vertex> vertices, std::span<GLuint> indices) {
+    auto triangleCount{indices.size() / 3};
+    auto side{orientation(vertices, indices)};
+    // unit face normals, zero for degenerate triangles
+    std::vector<glm::vec3> normals(triangleCount);
+    for (std::size_t t{0}; t < triangleCount; t++) {
+        auto a{vertices[indices[3 * t]].position}, b{vertices[indices[3 * t + 1]].position},
+            c{vertices[indices[3 * t + 2]].position};
+        auto normal{glm::cross(b - a, c - a)};
+        auto length{glm::length(normal)};
+        if (length > 0.0f) normals[t] = normal / length;
+    }
+    // triangles of each vertex
+    std::vector<std::uint32_t> firstTriangle(vertices.size() + 1, 0);
+    std::vector<std::uint32_t> vertexTriangles(indices.size());
+    for (auto index : indices) firstTriangle[index + 1]++;
+    for (std::size_t v{0}; v < vertices.size(); v++) firstTriangle[v + 1] += firstTriangle[v];
+    {
+        auto fill{firstTriangle};
+        for (std::size_t i{0}; i < indices.size(); i++)
+            vertexTriangles[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+    }
+
+    std::vector<bool> assigned(triangleCount, false);
+    // the meshlet a vertex was last taken into
+    std::vector<std::size_t> owner(vertices.size(), std::numeric_limits<std::size_t>::max());
+    std::vector<GLuint> ordered;
+    ordered.reserve(indices.size());
+    std::vector<Meshlet> meshlets;
+    std::vector<std::uint32_t> members, candidates, meshletVertices;
+    std::size_t seed{0};
+    while (true) {
+        while (seed < triangleCount && assigned[seed]) seed++;
+        if (seed == triangleCount) break;
+        auto id{meshlets.size()};
+        members.clear();
+        meshletVertices.clear();
+        candidates.assign(1, static_cast<std::uint32_t>(seed));
+        glm::vec3 normalSum{0.0f};
+        while (members.size() < MAX_TRIANGLES) {
+            auto length{glm::length(normalSum)};
+            auto axis{length > 0.0f ? normalSum / length : glm::vec3(0.0f)};
+            std::optional<std::size_t> best;
+            auto bestScore{std::numeric_limits<float>::max()};
+            for (std::size_t i{0}; i < candidates.size();) {
+                auto t{candidates[i]};
+                // taken since it became a candidate: drop it
+                if (assigned[t]) {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                auto added{0uz};
+                for (int c{0}; c < 3; c++) added += owner[indices[3 * t + c]] != id;
+                if (meshletVertices.size() + added <= MAX_VERTICES) {
+                    auto score{added + CONE_WEIGHT * (1.0f - glm::dot(normals[t], axis))};
+                    if (score < bestScore) {
+                        best = i;
+                        bestScore = score;
+                    }
+                }
+                i++;
+            }
+            if (!best) break;
+
+            auto t{candidates[*best]};
+            candidates[*best] = candidates.back();
+            candidates.pop_back();
+            assigned[t] = true;
+            members.push_back(t);
+            normalSum += normals[t];
+            for (int c{0}; c < 3; c++) {
+                auto v{indices[3 * t + c]};
+                if (owner[v] == id) continue;
+                owner[v] = id;
+                meshletVertices.push_back(v);
+                for (auto i{firstTriangle[v]}; i < firstTriangle[v + 1]; i++) {
+                    if (!assigned[vertexTriangles[i]]) candidates.push_back(vertexTriangles[i]);
+                }
+            }
+        }
+
+        Meshlet meshlet{static_cast<GLuint>(ordered.size()),
+                        static_cast<GLsizei>(3 * members.size())};
+        for (auto t : members) {
+            for (int c{0}; c < 3; c++) ordered.push_back(indices[3 * t + c]);
+        }
+        // the sphere around the center of the box
+        Aabb box;
+        for (auto v : meshletVertices) box.add(vertices[v].position);
+        auto center{box.center()};
+        auto radius{0.0f};
+        for (auto v : meshletVertices)
+            radius = std::max(radius, glm::length(vertices[v].position - center));
+        meshlet.sphere = glm::vec4(center, radius);
+        // the cone of the normals, as they face from outside
+        auto length{glm::length(normalSum)};
+        if (side != 0.0f && length > 0.0f) {
+            auto axis{normalSum / length};
+            auto minCosine{1.0f};
+            for (auto t : members) {
+                if (normals[t] != glm::vec3(0.0f))
+                    minCosine = std::min(minCosine, glm::dot(normals[t], axis));
+            }
+            if (minCosine > MIN_CONE_COSINE)
+                meshlet.cone = glm::vec4(axis * side, std::sqrt(1.0f - minCosine * minCosine));
+        }
+        meshlets.push_back(meshlet);
+    }
+    std::ranges::copy(ordered, indices.begin());
+    return meshlets;
+}
@@ -0,0 +1,25 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include <span>
+#include <vector>
+
+#include "mesh.hpp"
+
+// Splits the triangle list `indices` over `vertices` into meshlets of at most 64 vertices and
+// 124 triangles, reordering `indices` in place so each meshlet is a contiguous range of it.
+// Returns the meshlets with their ranges relative to the start of `indices`.
+//
+// A meshlet grows from a seed triangle over the triangles sharing its vertices, taking the one
+// that adds the fewest vertices and, among those, the one closest in normal to what it holds,
+// to keep the normal cones narrow. Cones are only set up for back-facing tests where the range
+// is closed and consistently wound, welded by position; elsewhere the back of a triangle may be
+// what is seen.
+std::vector<Meshlet> buildMeshlets(std::span<const Vertex> vertices, std::span<GLuint> indices);
+
+#endif
@@ -15,42 +15,119 @@
 #include <assimp/postprocess.h>
 
 #include "shader.h"
-#include "mesh.hpp"
-
+#include "mesh_pool.hpp"
+#include "mesh_simplifier.h"
+#include "draw_constants.hpp"
+#include "frustum.hpp"
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <optional>
+#include <span>
 #include <vector>
 
+// Where a pass looks from, to pick each mesh's level of detail by its error on screen: the
+// coarsest one whose error, projected at the mesh's nearest distance, stays within
+// maxPixelError.
+struct LodView {
+    glm::vec3 eye;
+    // pixels one unit of length covers at distance 1: viewport height / (2 tan(fovy / 2))
+    float pixelsPerUnit;
+    float maxPixelError;
+
+    LodView(const glm::vec3& eye, float viewportHeight, float fovy, float maxPixelError)
+        : eye{eye}, pixelsPerUnit{viewportHeight / (2.0f * std::tan(fovy / 2.0f))},
+          maxPixelError{maxPixelError} {}
+};
+
 class Model {
 public:
+    // levels of detail of each mesh past the full one, each about half the triangles of the one
+    // before
+    static constexpr int maxLods{5};
+
     // model data
-    std::vector<Mesh> meshes;
+    MeshPool meshes;
     std::string directory;
     bool gammaCorrection;
+    // whether draw() culls the meshlets of the meshes it draws as well
+    bool meshletCulling{true};
 
-    // constructor, expects a filepath to a 3D model.
-    Model(const std::string& path, bool gamma = false) : gammaCorrection{gamma} {
+    // constructor, expects a filepath to a 3D model. The vertices and indices stay readable in
+    // `meshes` after upload if `retainMeshData`.
+    Model(const std::string& path, bool gamma = false, bool retainMeshData = false)
+        : gammaCorrection{gamma} {
         loadModel(path);
+        meshes.upload(retainMeshData);
     }
 
-    // draws the model, and thus all its meshes
-    void draw(Shader& shader) {
+    // draws the model, and thus all its meshes, at the levels of detail `view` picks; a mesh
+    // whose box is outside all of `frustums`, or hidden by `occlusion` if given, is culled, and
+    // so is a meshlet of a mesh drawn that faces away from the eye of `view` or whose sphere is
+    // outside all of `frustums`
+    DrawStats draw(Shader& shader, const glm::mat4& viewProjection, const LodView& view,
+                   std::span<const Frustum> frustums, OcclusionCulling* occlusion = nullptr) {
         shader.use();
-
-        // translate to our scene, then rotate 1r/4s
-        auto model{glm::translate(glm::mat4(1.0f), {-7.0f, 0.f, 7.f})};
-        shader.setUniform(
-            "model", glm::rotate(model, static_cast<float>(glfwGetTime() * std::numbers::pi / 4.0),
-                                 glm::vec3(0.0, 1.0, 0.0)));
+        auto model{transform()};
+        DrawConstants::set(model, viewProjection);
+        auto modelEye{glm::vec3(glm::inverse(model) * glm::vec4(view.eye, 1.0f))};
 
         shader.setUniform("material.diffuse", 0.8f, 0.8f, 0.8f);
-        for (const auto& i : meshes) i.draw(shader);
+        auto occluded{0uz};
+        auto levelOf{[&](const Mesh& mesh) -> std::optional<std::size_t> {
+            auto box{mesh.box.transformed(model)};
+            auto inside{[&](const Frustum& frustum) { return frustum.intersects(box); }};
+            if (std::ranges::none_of(frustums, inside)) return std::nullopt;
+            if (occlusion && !occlusion->visible(&mesh, box)) {
+                occluded++;
+                return std::nullopt;
+            }
+            auto center{glm::vec3(model * glm::vec4(glm::vec3(mesh.sphere), 1.0f))};
+            auto distance{std::max(glm::length(center - view.eye) - mesh.sphere.w, 1e-3f)};
+            auto level{0uz};
+            while (level + 1 < mesh.lods.size() &&
+                   mesh.lods[level + 1].error * view.pixelsPerUnit / distance <=
+                       view.maxPixelError)
+                level++;
+            return level;
+        }};
+        auto keepMeshlet{[&](const Meshlet& meshlet) {
+            if (!meshletCulling) return true;
+            if (meshlet.backFacing(modelEye)) return false;
+            auto center{glm::vec3(model * glm::vec4(glm::vec3(meshlet.sphere), 1.0f))};
+            auto inside{[&](const Frustum& frustum) {
+                return frustum.intersects(center, meshlet.sphere.w);
+            }};
+            return std::ranges::any_of(frustums, inside);
+        }};
+        auto stats{meshes.draw(levelOf, keepMeshlet)};
+        stats.culled -= occluded;
+        stats.occluded = occluded;
+        return stats;
+    }
+
+    // bounding sphere in world space where the model is right now, radius in w
+    glm::vec4 bounds() const {
+        return glm::vec4(glm::vec3(transform() * glm::vec4(glm::vec3(sphere), 1.0f)), sphere.w);
     }
 
 private:
+    // bounding sphere of all the meshes in model space, radius in w
+    glm::vec4 sphere{0.0f};
+
+    // translate to our scene, then rotate 1r/4s
+    static glm::mat4 transform() {
+        auto model{glm::translate(glm::mat4(1.0f), {-7.0f, 0.f, 7.f})};
+        return glm::rotate(model, static_cast<float>(glfwGetTime() * std::numbers::pi / 4.0),
+                           glm::vec3(0.0, 1.0, 0.0));
+    }
 
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in
     // the meshes vector.
@@ -70,6 +147,20 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        // around the center of the bounding box, while the vertices are still on the CPU
+        const auto& vertices{meshes.getVertices()};
+        if (vertices.empty()) return;
+        glm::vec3 low{std::numeric_limits<float>::max()}, high{-low};
+        for (const auto& vertex : vertices) {
+            low = glm::min(low, vertex.position);
+            high = glm::max(high, vertex.position);
+        }
+        glm::vec3 center{(low + high) * 0.5f};
+        auto radius{0.0f};
+        for (const auto& vertex : vertices)
+            radius = std::max(radius, glm::length(vertex.position - center));
+        sphere = glm::vec4(center, radius);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node
@@ -81,7 +172,7 @@ private:
             // the scene contains all the data, node is just to keep stuff organized (like relations
             // between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            processMesh(mesh, scene);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the
         // children nodes
@@ -90,35 +181,46 @@ private:
         }
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene) {
-        // data to fill
-        std::vector<Vertex> vertices;
-        std::vector<GLuint> indices;
+    // appends the mesh to the pool, written in place, and its levels of detail
+    void processMesh(aiMesh* mesh, const aiScene* scene) {
+        auto indexCount{0uz};
+        for (auto i{0uz}; i < mesh->mNumFaces; i++) indexCount += mesh->mFaces[i].mNumIndices;
+        auto [vertices, indices]{meshes.add(mesh->mNumVertices, indexCount)};
 
         // walk through each of the mesh's vertices
         for (auto i{0uz}; i < mesh->mNumVertices; i++) {
-            Vertex vertex;
+            auto& vertex{vertices[i]};
             vertex.position = {mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z};
             if (mesh->HasNormals()) {
                 vertex.normal = {mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z};
             }
-            vertices.push_back(vertex);
         }
 
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the
         // corresponding vertex indices.
+        auto index{0uz};
         for (auto i{0uz}; i < mesh->mNumFaces; i++) {
-            auto face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for (auto j{0uz}; j < face.mNumIndices; j++) {
-                indices.push_back(face.mIndices[j]);
-            }
+            const auto& face{mesh->mFaces[i]};
+            // retrieve all indices of the face and store them in the indices span
+            for (auto j{0uz}; j < face.mNumIndices; j++) indices[index++] = face.mIndices[j];
         }
 
         // do not need to process materials
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices);
+        // each level of detail from the one before, until one no longer pays off
+        for (int level{0}; level < maxLods; level++) {
+            const auto& added{meshes.getMeshes().back()};
+            auto previous{added.lods.back()};
+            if (previous.indexCount < 3 * 64) break;
+            auto lodError{0.0f};
+            auto simplified{simplifyMesh(
+                std::span(meshes.getVertices()).subspan(added.baseVertex, added.vertexCount),
+                std::span(meshes.getIndices()).subspan(previous.firstIndex, previous.indexCount),
+                previous.indexCount / 2, lodError)};
+            if (simplified.size() * 4 > previous.indexCount * 3uz) break;
+            // the error of this level adds to that of the one it was made from
+            meshes.addLod(simplified, previous.error + lodError);
+        }
     }
 };
 
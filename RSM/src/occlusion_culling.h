@@ -0,0 +1,114 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "aabb.hpp"
+#include "shader.h"
+
+// Occlusion culling of the camera passes against the depth of an earlier frame. After the
+// camera passes, their depth is reduced on the gpu to a pyramid of farthest depths
+// (hiz_reduce.frag) down to a level of at most READBACK_SIZE texels a side; that level is read
+// back without stalling and reduced the rest of the way on the cpu. A draw is hidden when the
+// nearest depth of its world box lies behind the farthest depth under the box's screen
+// rectangle, at the level where the rectangle spans at most two texels. Boxes are projected
+// with the view projection the pyramid was rendered with, not this frame's.
+//
+// The pyramid is a frame or two old and seen from where the camera was then, so a draw hidden
+// by a thin margin is borderline: it is skipped, and its box is drawn under a
+// GL_ANY_SAMPLES_PASSED query against this frame's depth. The result is read the next frame,
+// only if it is available; if any sample passed, the draw is made for a few frames whatever the
+// pyramid says, until a pyramid with the draw in it has arrived.
+class OcclusionCulling {
+public:
+    // side of the largest pyramid level read back
+    static constexpr unsigned READBACK_SIZE{128};
+    // how far behind its occluders, in view distance, a hidden draw is not borderline
+    static constexpr float BORDERLINE_DISTANCE{1.0f};
+    // frames a draw confirmed by its query is made regardless of the pyramid
+    static constexpr unsigned CONFIRMED_FRAMES{4};
+
+    // `near` and `far` of the camera projection
+    OcclusionCulling(float near, float far);
+    OcclusionCulling(const OcclusionCulling&) = delete;
+    ~OcclusionCulling();
+
+    // starts the tests of a frame seen through `viewProjection`, taking in a finished readback
+    void beginFrame(const glm::mat4& viewProjection);
+    // whether the draw `key`, a stable address of the caller's, with the world box `box` may be
+    // visible; every pass of a frame gets the first answer
+    bool visible(const void* key, const Aabb& box);
+    // queries of this frame's borderline draws against the depth of the bound framebuffer;
+    // `boxShader` draws a unit cube through the DrawConstants mvp
+    void confirm(Shader& boxShader);
+    // builds the pyramid of `depthMap`, the `width` x `height` depth of this frame's camera
+    // passes, with `reduceShader` over the fullscreen triangle of `fullscreenVao`, and starts
+    // its readback
+    void capture(Shader& reduceShader, GLuint fullscreenVao, GLuint depthMap, unsigned width,
+                 unsigned height);
+
+private:
+    struct Entry {
+        Aabb box;
+        GLuint query{0};
+        // the query is in flight
+        bool queried{false};
+        unsigned confirmedUntil{0};
+        unsigned frame{0};
+        bool visible{true};
+    };
+    enum class Verdict { visible, hidden, borderline };
+
+    float near, far;
+    unsigned frame{1};
+    // this frame's, for the boxes of the queries and the next capture
+    glm::mat4 viewProjection{1.0f};
+    std::unordered_map<const void*, Entry> entries;
+    std::vector<Entry*> borderline;
+    GLuint cubeVao, cubeVbo, cubeEbo;
+
+    // gpu pyramid, level 0 at half the depth's size, down to readLevel
+    GLuint pyramid;
+    std::vector<GLuint> levelFbos;
+    unsigned depthWidth{0}, depthHeight{0};
+    int readLevel{0};
+    std::vector<glm::uvec2> levelSizes;
+
+    // readback, double buffered; each slot with the view projection, depth size and read level
+    // it was taken at
+    std::array<GLuint, 2> pbo;
+    std::array<GLsync, 2> fence{};
+    std::array<glm::mat4, 2> readViewProjection{};
+    std::array<glm::uvec2, 2> readDepthSize{};
+    std::array<glm::uvec2, 2> readSize{};
+    std::array<int, 2> readShift{};
+    int slot{0};
+
+    // cpu pyramid, finest (the level read back) first, each row major from the bottom row
+    std::vector<std::vector<float>> levels;
+    std::vector<glm::uvec2> cpuSizes;
+    // the view projection and depth size it comes from, and how many halvings lie between that
+    // and levels[0]
+    glm::mat4 cpuViewProjection{1.0f};
+    glm::uvec2 cpuDepthSize{0};
+    int cpuShift{0};
+
+    void resize(unsigned width, unsigned height);
+    void update();
+    Verdict test(const Aabb& box) const;
+    float linearDepth(float depth) const;
+};
+
+#endif
@@ -0,0 +1,186 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef RSM_TARGET_H
+#define RSM_TARGET_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Render targets of the reflective shadow maps, one layer of texture arrays per rsm face (a
+// spotlight has one, a point light six) and a framebuffer per layer and layout around a shared
+// depth map, plus a layered one per layout that a geometry shader routes faces through. The
+// reference layout stores normal and world position as RGB32F and an 8 bit flux; the compact
+// one keeps an octahedral RG16_SNORM normal and an R11F_G11F_B10F flux, the position is rebuilt
+// from depth. Only the maps of the current layout are allocated, the others are kept at zero
+// size so that switching reallocates them.
+class RsmTarget {
+public:
+    GLuint depthMap;
+    GLuint normalMap, worldPosMap, fluxMap;
+    GLuint compactNormalMap, compactFluxMap;
+
+    RsmTarget(unsigned width, unsigned height, unsigned layers, bool compact)
+        : width{0}, height{0}, layers{0}, compact{compact}, layeredFbos{} {
+        const glm::vec4 all1(1.0f, 1.0f, 1.0f, 1.0f);
+        const glm::vec4 all0(0.0f, 0.0f, 0.0f, 0.0f);
+        depthMap = create(all0);
+        // reference layout
+        normalMap = create(all0);
+        worldPosMap = create(all1);
+        fluxMap = create(all0);
+        // compact layout; a zero flux border keeps samples outside the map dark, whatever the
+        // normal and position decode to there
+        compactNormalMap = create(all0);
+        compactFluxMap = create(all0);
+        resize(width, height, layers, compact);
+    }
+    RsmTarget(const RsmTarget&) = delete;
+
+    ~RsmTarget() {
+        glDeleteFramebuffers(fbos.size(), fbos.data());
+        glDeleteFramebuffers(compactFbos.size(), compactFbos.data());
+        glDeleteFramebuffers(2, layeredFbos);
+        GLuint textures[]{depthMap,  normalMap,        worldPosMap,
+                          fluxMap,   compactNormalMap, compactFluxMap};
+        glDeleteTextures(6, textures);
+    }
+
+    unsigned getWidth() const {
+        return width;
+    }
+    unsigned getHeight() const {
+        return height;
+    }
+    unsigned getLayers() const {
+        return layers;
+    }
+
+    // reallocates depth and the maps of `c`'s layout at `w` x `h` x `l` layers and frees the
+    // other layout's, keeping the texture names (and so the texture units they are bound to);
+    // nothing happens if that is the current size and layout
+    void resize(unsigned w, unsigned h, unsigned l, bool c) {
+        if (w == width && h == height && l == layers && c == compact) return;
+        width = w;
+        height = h;
+        compact = c;
+        auto reference{compact ? 0 : l}, compactLayers{compact ? l : 0};
+        specify(depthMap, GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT, l);
+        specify(normalMap, GL_RGB32F, GL_RGB, reference);
+        specify(worldPosMap, GL_RGB32F, GL_RGB, reference);
+        specify(fluxMap, GL_RGB, GL_RGB, reference);
+        specify(compactNormalMap, GL_RG16_SNORM, GL_RG, compactLayers);
+        specify(compactFluxMap, GL_R11F_G11F_B10F, GL_RGB, compactLayers);
+        if (l != layers) {
+            layers = l;
+            createFramebuffers();
+        }
+    }
+
+    // framebuffer of layer `layer` in `compact`'s layout
+    GLuint framebuffer(bool compact, unsigned layer) const {
+        return compact ? compactFbos[layer] : fbos[layer];
+    }
+    // framebuffer of every layer in `compact`'s layout, gl_Layer picks one
+    GLuint layeredFramebuffer(bool compact) const {
+        return layeredFbos[compact ? 1 : 0];
+    }
+
+    // copies depth and every map of `compact`'s layout in layer `layer` into the same layer of
+    // `target`, which must have the same size; leaves the default framebuffer bound
+    void copyTo(const RsmTarget& target, bool compact, unsigned layer) const {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer(compact, layer));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebuffer(compact, layer));
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT,
+                          GL_NEAREST);
+        // a color blit goes to every draw buffer, so copy one attachment at a time
+        for (int i{0}; i < colorCount(compact); i++) {
+            glReadBuffer(drawBuffers[i]);
+            glDrawBuffers(1, &drawBuffers[i]);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                              GL_NEAREST);
+        }
+        glDrawBuffers(colorCount(compact), drawBuffers);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+private:
+    static constexpr GLenum drawBuffers[]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+                                          GL_COLOR_ATTACHMENT2};
+    unsigned width, height, layers;
+    bool compact;
+    std::vector<GLuint> fbos, compactFbos;
+    GLuint layeredFbos[2];
+
+    static int colorCount(bool compact) {
+        return compact ? 2 : 3;
+    }
+
+    static GLuint create(const glm::vec4& border) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, &border[0]);
+        return texture;
+    }
+
+    // no layers frees the storage
+    void specify(GLuint texture, GLint internalFormat, GLenum format, unsigned l) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, l ? width : 0, l ? height : 0, l, 0,
+                     format, GL_FLOAT, nullptr);
+    }
+
+    // one framebuffer per layer and layout, and a layered one per layout (set
+    // light_space_shader output)
+    void createFramebuffers() {
+        glDeleteFramebuffers(fbos.size(), fbos.data());
+        glDeleteFramebuffers(compactFbos.size(), compactFbos.data());
+        if (!layeredFbos[0]) glGenFramebuffers(2, layeredFbos);
+        glBindFramebuffer(GL_FRAMEBUFFER, layeredFbos[0]);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, normalMap, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, worldPosMap, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, fluxMap, 0);
+        glDrawBuffers(colorCount(false), drawBuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, layeredFbos[1]);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, compactNormalMap, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, compactFluxMap, 0);
+        glDrawBuffers(colorCount(true), drawBuffers);
+
+        fbos.resize(layers);
+        compactFbos.resize(layers);
+        glGenFramebuffers(layers, fbos.data());
+        glGenFramebuffers(layers, compactFbos.data());
+        for (unsigned layer{0}; layer < layers; layer++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbos[layer]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0, layer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, normalMap, 0, layer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, worldPosMap, 0,
+                                      layer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, fluxMap, 0, layer);
+            glDrawBuffers(colorCount(false), drawBuffers);
+            glBindFramebuffer(GL_FRAMEBUFFER, compactFbos[layer]);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthMap, 0, layer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, compactNormalMap, 0,
+                                      layer);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, compactFluxMap, 0,
+                                      layer);
+            glDrawBuffers(colorCount(true), drawBuffers);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,126 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#include "sample_sets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <random>
+
+std::vector<std::array<float, 2>> sobolPoints(std::size_t count, std::uint32_t seed) {
+    std::mt19937 random(seed);
+    // a digital shift keeps the stratification of the sequence
+    std::uint32_t shift[]{static_cast<std::uint32_t>(random()),
+                          static_cast<std::uint32_t>(random())};
+    std::vector<std::array<float, 2>> points(count);
+    for (std::uint32_t i{0}; i < count; i++) {
+        // first dimension: van der Corput, the bit reversed index
+        std::uint32_t x{0};
+        for (std::uint32_t bits{i}, v{1u << 31}; bits; bits >>= 1, v >>= 1)
+            if (bits & 1) x ^= v;
+        // second dimension: direction numbers of the polynomial x + 1
+        std::uint32_t y{0};
+        for (std::uint32_t bits{i}, v{1u << 31}; bits; bits >>= 1, v ^= v >> 1)
+            if (bits & 1) y ^= v;
+        points[i] = {std::ldexp(static_cast<float>((x ^ shift[0]) >> 8), -24),
+                     std::ldexp(static_cast<float>((y ^ shift[1]) >> 8), -24)};
+    }
+    return points;
+}
+
+std::vector<std::array<float, 3>> rsmSampleOffsets(std::size_t count, std::uint32_t seed) {
+    std::vector<std::array<float, 3>> offsets;
+    offsets.reserve(count);
+    for (auto [r, angle] : sobolPoints(count, seed)) {
+        offsets.push_back({r * std::sin(2 * std::numbers::pi_v<float> * angle),
+                           r * std::cos(2 * std::numbers::pi_v<float> * angle), r * r});
+    }
+    return offsets;
+}
+
+std::vector<float> blueNoise(int size, std::uint32_t seed) {
+    auto n{size * size};
+    // toroidal gaussian of sigma 1.5, so the texture tiles
+    std::vector<float> kernel(n);
+    for (int y{0}; y < size; y++) {
+        for (int x{0}; x < size; x++) {
+            auto dx{std::min(x, size - x)};
+            auto dy{std::min(y, size - y)};
+            kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * 1.5f * 1.5f));
+        }
+    }
+    std::vector<char> pattern(n, 0);
+    std::vector<float> energy(n, 0.0f);
+    auto set{[&](int p, bool on) {
+        pattern[p] = on;
+        auto sign{on ? 1.0f : -1.0f};
+        auto px{p % size}, py{p / size};
+        for (int y{0}; y < size; y++) {
+            auto row{(y - py + size) % size * size};
+            for (int x{0}; x < size; x++)
+                energy[y * size + x] += sign * kernel[row + (x - px + size) % size];
+        }
+    }};
+    // the set point with the most set neighbours, and the unset one with the fewest
+    constexpr auto infinity{std::numeric_limits<float>::infinity()};
+    auto tightestCluster{[&] {
+        auto best{0};
+        for (int p{1}; p < n; p++)
+            if ((pattern[p] ? energy[p] : -infinity) > (pattern[best] ? energy[best] : -infinity))
+                best = p;
+        return best;
+    }};
+    auto largestVoid{[&] {
+        auto best{0};
+        for (int p{1}; p < n; p++)
+            if ((pattern[p] ? infinity : energy[p]) < (pattern[best] ? infinity : energy[best]))
+                best = p;
+        return best;
+    }};
+
+    // initial pattern: a tenth of the points at random, moved from clusters into voids until
+    // that no longer changes anything
+    std::mt19937 random(seed);
+    auto initialCount{n / 10};
+    for (auto count{0}; count < initialCount;) {
+        auto p{static_cast<int>(random() % n)};
+        if (!pattern[p]) {
+            set(p, true);
+            count++;
+        }
+    }
+    for (;;) {
+        auto cluster{tightestCluster()};
+        set(cluster, false);
+        auto gap{largestVoid()};
+        set(gap, true);
+        if (gap == cluster) break;
+    }
+
+    // ranks: the initial points from the tightest cluster down, then the rest into the largest
+    // void each (Ulichney's third phase inverts the energy instead; filling voids is close
+    // enough at this size)
+    std::vector<int> rank(n);
+    auto initialPattern{pattern};
+    auto initialEnergy{energy};
+    for (auto r{initialCount - 1}; r >= 0; r--) {
+        auto cluster{tightestCluster()};
+        set(cluster, false);
+        rank[cluster] = r;
+    }
+    pattern = std::move(initialPattern);
+    energy = std::move(initialEnergy);
+    for (auto r{initialCount}; r < n; r++) {
+        auto gap{largestVoid()};
+        set(gap, true);
+        rank[gap] = r;
+    }
+
+    std::vector<float> noise(n);
+    for (int p{0}; p < n; p++) noise[p] = (rank[p] + 0.5f) / n;
+    return noise;
+}
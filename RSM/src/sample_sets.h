@@ -0,0 +1,34 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef SAMPLE_SETS_H
+#define SAMPLE_SETS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Deterministic sample sets of the rsm gather, shared with tools/sample_benchmark.cpp.
+
+// every run builds the same sets from this seed
+constexpr std::uint32_t SAMPLE_SEED{0x5eed5u};
+// side of the tiled blue noise texture
+constexpr int BLUE_NOISE_SIZE{64};
+
+// first `count` points of the 2D Sobol sequence in [0, 1)^2, XOR scrambled from `seed`. Every
+// aligned block of 2^k points stratifies the unit square into 2^k cells of any aspect ratio, so
+// each sample count of the ui (and each per-frame block of the temporal gather) is well spread.
+std::vector<std::array<float, 2>> sobolPoints(std::size_t count, std::uint32_t seed);
+
+// the gather's offsets in the unit disk (xy) and their weights (z): Sobol points mapped to radius
+// and angle, weighted by the squared radius as in the rsm paper
+std::vector<std::array<float, 3>> rsmSampleOffsets(std::size_t count, std::uint32_t seed);
+
+// `size` x `size` tileable blue noise, row major: ranks from void-and-cluster spread evenly over
+// [0, 1). Around 0.1 s for 64 x 64 in an optimized build, so it runs once at startup.
+std::vector<float> blueNoise(int size, std::uint32_t seed);
+
+#endif
@@ -5,55 +5,76 @@
 
 #include "shader.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-    // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+#include <filesystem>
+
+#include "embedded_shaders.h"
+
+namespace {
+
+// shaders listed in src/CMakeLists.txt are embedded by file name; anything else is read from
+// `path` as is, without #include support
+std::string loadSource(const char* path) {
+    if (auto source{embeddedShader(std::filesystem::path(path).filename().string())})
+        return source;
+    std::ifstream file;
     // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     try {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        file.open(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
     } catch (std::ifstream::failure& e) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+        return {};
     }
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment;
-    // vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, nullptr);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    // fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, nullptr);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    // shader Program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
-    // delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+}
+
+}  // namespace
+
+Shader::Shader(const char* vertexPath, const char* geometryPath, const char* fragmentPath,
+               Shader* fallback, const ShaderDefines& defines)
+    : fallback{fallback}, pending{true} {
+    // 1. look the sources up in the executable, or read them from disk
+    auto vertexCode{ProgramCache::specialize(loadSource(vertexPath), defines)};
+    auto fragmentCode{ProgramCache::specialize(loadSource(fragmentPath), defines)};
+    // 2. submit compile and link, or reuse the program binary of a previous launch
+    if (geometryPath) {
+        auto geometryCode{ProgramCache::specialize(loadSource(geometryPath), defines)};
+        ID = ProgramCache::submit({{GL_VERTEX_SHADER, vertexCode.c_str()},
+                                   {GL_GEOMETRY_SHADER, geometryCode.c_str()},
+                                   {GL_FRAGMENT_SHADER, fragmentCode.c_str()}},
+                                  checkCompileErrors);
+    } else {
+        ID = ProgramCache::submit(
+            {{GL_VERTEX_SHADER, vertexCode.c_str()}, {GL_FRAGMENT_SHADER, fragmentCode.c_str()}},
+            checkCompileErrors);
+    }
+}
+
+bool Shader::ready() {
+    if (!pending) return true;
+    if (!ProgramCache::ready(ID)) return false;
+    pending = false;
+    glUseProgram(ID);
+    for (auto& [name, set] : replay) set(glGetUniformLocation(ID, name.c_str()));
+    replay.clear();
+    return true;
+}
+
+void Shader::use() {
+    if (ready())
+        glUseProgram(ID);
+    else if (fallback)
+        fallback->use();
+    else
+        glUseProgram(ProgramCache::placeholder());
+}
+
+void Shader::defer(const std::string& name, std::function<void(GLint)> set) const {
+    // the fallback is what use() bound
+    if (fallback) fallback->applyUniform(name, set);
+    replay.insert_or_assign(name, std::move(set));
 }
 
 void Shader::checkCompileErrors(GLuint shader, const std::string& type) {
@@ -76,4 +97,25 @@ void Shader::checkCompileErrors(GLuint shader, const std::string& type) {
                       << std::endl;
         }
     }
-}
\ No newline at end of file
+}
+
+Shader& ShaderPermutations::prepare(const ShaderDefines& defines) {
+    auto& variant{variants[defines]};
+    if (!variant) {
+        // the variant selected right now stands in while this one compiles
+        variant = std::make_unique<Shader>(
+            vertexPath.c_str(), geometryPath.empty() ? nullptr : geometryPath.c_str(),
+            fragmentPath.c_str(), active ? active : fallback, defines);
+    }
+    return *variant;
+}
+
+Shader& ShaderPermutations::select(const ShaderDefines& defines) {
+    auto& variant{prepare(defines)};
+    variant.use();
+    if (&variant != active) {
+        active = &variant;
+        for (auto& [name, set] : persistent) set(variant);
+    }
+    return variant;
+}
@@ -11,61 +11,146 @@
 #include <glm/glm.hpp>
 
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 
+#include "program_cache.h"
+
 class Shader {
 public:
     unsigned int ID;
-    Shader(const char* vertexPath, const char* fragmentPath);
+    // the program is compiled and linked in the background; until it is ready, use() binds
+    // `fallback` (or a program that draws nothing) and uniforms are replayed afterwards.
+    // `defines` are injected into both stages, see ShaderPermutations.
+    Shader(const char* vertexPath, const char* fragmentPath, Shader* fallback = nullptr,
+           const ShaderDefines& defines = {})
+        : Shader(vertexPath, nullptr, fragmentPath, fallback, defines) {}
+    // with a geometry stage, unless `geometryPath` is null
+    Shader(const char* vertexPath, const char* geometryPath, const char* fragmentPath,
+           Shader* fallback = nullptr, const ShaderDefines& defines = {});
+
+    // true once the program finished linking; only waits for the driver when it lacks
+    // parallel shader compile
+    bool ready();
 
     // activate the shader
-    void use() {
-        glUseProgram(ID);
-    }
+    void use();
 
     // utility uniform functions
     void setUniform(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        applyUniform(name, [=](GLint location) { glUniform1i(location, (int)value); });
     }
     void setUniform(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        applyUniform(name, [=](GLint location) { glUniform1i(location, value); });
     }
     void setUniform(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        applyUniform(name, [=](GLint location) { glUniform1f(location, value); });
     }
     void setUniform(const std::string& name, const glm::vec2& value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        applyUniform(name, [=](GLint location) { glUniform2fv(location, 1, &value[0]); });
     }
     void setUniform(const std::string& name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        applyUniform(name, [=](GLint location) { glUniform2f(location, x, y); });
     }
     void setUniform(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        applyUniform(name, [=](GLint location) { glUniform3fv(location, 1, &value[0]); });
     }
     void setUniform(const std::string& name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        applyUniform(name, [=](GLint location) { glUniform3f(location, x, y, z); });
     }
     void setUniform(const std::string& name, const glm::vec4& value) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        applyUniform(name, [=](GLint location) { glUniform4fv(location, 1, &value[0]); });
     }
     void setUniform(const std::string& name, float x, float y, float z, float w) {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        applyUniform(name, [=](GLint location) { glUniform4f(location, x, y, z, w); });
     }
     void setUniform(const std::string& name, const glm::mat2& mat) const {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        applyUniform(name, [=](GLint location) {
+            glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+        });
     }
     void setUniform(const std::string& name, const glm::mat3& mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        applyUniform(name, [=](GLint location) {
+            glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+        });
     }
     void setUniform(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        applyUniform(name, [=](GLint location) {
+            glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+        });
     }
 
 private:
+    Shader* fallback;
+    bool pending;
+    // last value of every uniform set while the program was not ready
+    mutable std::map<std::string, std::function<void(GLint)>> replay;
+
+    template <typename Set>
+    void applyUniform(const std::string& name, Set set) const {
+        if (pending)
+            defer(name, set);
+        else
+            set(glGetUniformLocation(ID, name.c_str()));
+    }
+    void defer(const std::string& name, std::function<void(GLint)> set) const;
+
     // utility function for checking shader compilation/linking errors.
-    void checkCompileErrors(GLuint shader, const std::string& type);
+    static void checkCompileErrors(GLuint shader, const std::string& type);
+};
+
+// Variants of one shader pair specialized by their #defines, compiled the first time they are
+// asked for and kept by key. Uniforms set through here are remembered and handed to whichever
+// variant is selected later, so switching variants keeps the configuration.
+class ShaderPermutations {
+public:
+    ShaderPermutations(std::string vertexPath, std::string fragmentPath,
+                       Shader* fallback = nullptr)
+        : vertexPath{std::move(vertexPath)},
+          fragmentPath{std::move(fragmentPath)},
+          fallback{fallback},
+          active{nullptr} {}
+    // with a geometry stage
+    ShaderPermutations(std::string vertexPath, std::string geometryPath,
+                       std::string fragmentPath)
+        : vertexPath{std::move(vertexPath)},
+          geometryPath{std::move(geometryPath)},
+          fragmentPath{std::move(fragmentPath)},
+          fallback{nullptr},
+          active{nullptr} {}
+
+    // starts compiling the variant for `defines` without selecting it
+    Shader& prepare(const ShaderDefines& defines);
+    // makes the variant for `defines` current and leaves it bound; until it is ready the
+    // previously selected variant keeps drawing in its place
+    Shader& select(const ShaderDefines& defines);
+
+    Shader& current() {
+        return *active;
+    }
+    void use() {
+        active->use();
+    }
+
+    template <typename... Args>
+    void setUniform(const std::string& name, const Args&... args) {
+        active->setUniform(name, args...);
+        persistent.insert_or_assign(name,
+                                    [=](Shader& shader) { shader.setUniform(name, args...); });
+    }
+
+private:
+    std::string vertexPath;
+    std::string geometryPath;  // empty without a geometry stage
+    std::string fragmentPath;
+    Shader* fallback;
+    std::map<ShaderDefines, std::unique_ptr<Shader>> variants;
+    Shader* active;
+    std::map<std::string, std::function<void(Shader&)>> persistent;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+#version 330 core
+// lighting pass of the deferred path, runs once per pixel of the g-buffer
+out vec4 FragColor;
+
+uniform sampler2D gNormalMap;
+uniform sampler2D gAlbedoMap;
+uniform sampler2D gDepthMap;
+
+#include "shading.glsl"
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepthMap, texel, 0).r;
+    // nothing was drawn here, keep the clear color
+    if (depth >= 1.0) discard;
+
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(gDepthMap, 0));
+    vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec3 position = world.xyz / world.w;
+    // the view matrix is rigid, its transpose takes normals back to world space
+    vec3 normal = transpose(mat3(view)) * octDecode(texelFetch(gNormalMap, texel, 0).xy);
+
+    vec3 result = shade(position, normal, texelFetch(gAlbedoMap, texel, 0).rgb);
+
+    // gamma correction
+    float gamma = 2.2;
+    FragColor = vec4(result, 1.0);
+    FragColor.rgb = pow(FragColor.rgb, vec3(1.0 / gamma));
+    // later forward draws (the light indicator) are depth tested against the scene
+    gl_FragDepth = depth;
+}
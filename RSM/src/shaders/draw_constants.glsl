@@ -0,0 +1,6 @@
+// per-draw block, see draw_constants.hpp
+layout (std140) uniform DrawConstants {
+    mat4 model;
+    mat4 normalMatrix;
+    mat4 mvp;
+};
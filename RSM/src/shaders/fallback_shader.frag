@@ -0,0 +1,21 @@
+#version 330 core
+in vec3 fsNormal;
+in vec3 fsPosition;
+
+out vec4 FragColor;
+
+#include "material.glsl"
+
+#include "frame_constants.glsl"
+#include "light_list.glsl"
+
+// plain lambert, shown while main_shader is still being compiled
+void main() {
+    vec3 norm = normalize(fsNormal);
+    vec3 color = light.ambient;
+    for (int i = 0; i < lightCount; i++) {
+        vec3 lightDir = normalize(lights[i].position.xyz - fsPosition);
+        color += max(0.0, dot(norm, lightDir)) * lights[i].diffuse.rgb;
+    }
+    FragColor = vec4(color * material.diffuse, 1.0);
+}
@@ -0,0 +1,7 @@
+// per-frame block, see frame_constants.hpp
+layout (std140) uniform FrameConstants {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseViewProjection;
+    vec4 viewPos;
+};
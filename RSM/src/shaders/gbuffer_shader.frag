@@ -0,0 +1,16 @@
+#version 330 core
+// thin g-buffer of the deferred path; depth comes from the depth attachment
+layout (location=0) out vec2 normal; // view space, octahedral
+layout (location=1) out vec4 albedo;
+
+in vec3 fsNormal;
+in vec3 fsPosition;
+
+#include "material.glsl"
+#include "frame_constants.glsl"
+#include "rsm_layout.glsl"
+
+void main() {
+    normal = octEncode(normalize(mat3(view) * fsNormal));
+    albedo = vec4(material.diffuse, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+// what the upsampling of low resolution indirect light compares against
+layout (location=0) out vec4 position; // world position, distance to the camera in w
+layout (location=1) out vec4 normal;
+
+in vec3 fsNormal;
+in vec3 fsPosition;
+
+#include "frame_constants.glsl"
+
+void main() {
+    position = vec4(fsPosition, length(fsPosition - viewPos.xyz));
+    normal = vec4(fsNormal, 0.0);
+}
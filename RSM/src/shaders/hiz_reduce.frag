@@ -0,0 +1,22 @@
+#version 330 core
+// one level of the occlusion culling pyramid, see occlusion_culling.h: the farthest depth of
+// the 2x2 source texels under this texel, and of the extra column or row the last texel of an
+// odd source side takes in
+out float depth;
+
+// the level before, or the depth of the camera passes for the first level
+uniform sampler2D source;
+
+void main() {
+    ivec2 size = textureSize(source, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    float farthest = 0.0;
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 3; x++) {
+            ivec2 texel = base + ivec2(x, y);
+            if ((x < 2 || texel.x == size.x - 1) && (y < 2 || texel.y == size.y - 1))
+                farthest = max(farthest, texelFetch(source, min(texel, size - 1), 0).r);
+        }
+    }
+    depth = farthest;
+}
@@ -0,0 +1,21 @@
+#version 330 core
+// rsm gather once per texel of the low resolution geometry target
+out vec3 indirect;
+
+uniform sampler2D geometryPositionMap;
+uniform sampler2D geometryNormalMap;
+
+#include "frame_constants.glsl"
+#include "rsm_layout.glsl"
+#include "rsm_gather.glsl"
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(geometryPositionMap, texel, 0);
+    // nothing was drawn here, the target is cleared to zero
+    if (position.w <= 0.0) {
+        indirect = vec3(0.0);
+        return;
+    }
+    indirect = rsmGather(position.xyz, texelFetch(geometryNormalMap, texel, 0).xyz);
+}
@@ -0,0 +1,17 @@
+// lights of the frame, see light_list.hpp; each has one rsm face (a spotlight) or six (a point
+// light, cube faces +x -x +y -y +z -z), each face a layer of the rsm arrays
+#define MAX_LIGHTS 4
+struct RsmLight {
+    mat4 lightSpaceMatrices[6];
+    mat4 inverseLightSpaceMatrices[6];
+    vec4 position;
+    vec4 diffuse;
+    vec2 rsmScale;
+    float rsmSampleShare;
+    int firstLayer;
+    int faceCount;
+};
+layout (std140) uniform LightList {
+    RsmLight lights[MAX_LIGHTS];
+    int lightCount;
+};
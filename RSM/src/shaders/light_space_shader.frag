@@ -1,39 +1,36 @@
 #version 330 core
+#ifdef RSM_COMPACT
+layout (location=0) out vec2 normal;
+layout (location=1) out vec3 flux;
+#else
 layout (location=0) out vec3 normal;
 layout (location=1) out vec3 worldPos;
 layout (location=2) out vec3 flux;
+#endif
 
 in vec3 fsNormal;
 in vec3 fsPosition;
 
-struct Material {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    float shininess;
-};
-uniform Material material;
+#include "material.glsl"
 
-struct Light {
-    vec3 position;
+#include "frame_constants.glsl"
+#include "rsm_layout.glsl"
 
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-uniform Light light;
+// light whose rsm layer is being drawn
+uniform int rsmLight;
 
 void main() {
+#ifdef RSM_COMPACT
+    // the position comes back from the depth buffer
+    normal = octEncode(normalize(fsNormal));
+#else
     normal = fsNormal;
     worldPos = fsPosition;
+#endif
 
-    vec3 lightDir = normalize(light.position - fsPosition);
+    vec3 lightDir = normalize(lights[rsmLight].position.xyz - fsPosition);
     vec3 norm = normalize(fsNormal);
     float diff = max(0.0, dot(norm, lightDir));
 
-    flux = diff * material.diffuse * light.diffuse;
+    flux = diff * material.diffuse * lights[rsmLight].diffuse.rgb;
 }
\ No newline at end of file
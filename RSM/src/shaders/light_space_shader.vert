@@ -2,15 +2,15 @@
 layout (location=0) in vec3 position;
 layout (location=1) in vec3 normal;
 
-out vec3 fsNormal;
-out vec3 fsPosition;
+out vec3 gsNormal;
+out vec3 gsPosition;
 
-uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+// world space only, light_space_shader.geom projects into each rsm face
+#include "draw_constants.glsl"
 
 void main() {
-    fsNormal = mat3(transpose(inverse(model))) * normal;
+    gsNormal = mat3(normalMatrix) * normal;
     vec4 worldPos = model * vec4(position, 1.0);
-    fsPosition = worldPos.xyz;
-    gl_Position = lightSpaceMatrix * model * vec4(position, 1.0f);
-}
\ No newline at end of file
+    gsPosition = worldPos.xyz;
+    gl_Position = worldPos;
+}
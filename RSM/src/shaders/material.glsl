@@ -0,0 +1,18 @@
+struct Material {
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+uniform Material material;
+
+// terms shared by all lights, their colors are in LightList
+struct Light {
+    vec3 ambient;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+uniform Light light;
@@ -0,0 +1,9 @@
+#version 330 core
+layout (location=0) in vec3 position;
+
+// mvp takes the unit cube to a world box, see occlusion_culling.h
+#include "draw_constants.glsl"
+
+void main() {
+    gl_Position = mvp * vec4(position, 1.0);
+}
@@ -0,0 +1,112 @@
+// The rsm indirect lighting gather over every light; needs rsm_layout.glsl.
+
+// one layer per light
+uniform sampler2DArray depthMap;
+uniform sampler2DArray normalMap;
+uniform sampler2DArray worldPosMap; // reference layout only
+uniform sampler2DArray fluxMap;
+uniform sampler2D randomMap;    // Sobol offsets in the unit disk, weight in z
+uniform sampler2D blueNoiseMap; // tiled per-pixel rotation of the offsets
+
+// most rsm samples of a light, injected per shader variant so the loop has a constant trip
+// count; each light stops at its own share of it
+#ifndef RSM_SAMPLE_NUM
+#define RSM_SAMPLE_NUM 256
+#endif
+
+uniform float shadowRadius;
+
+#ifdef RSM_SAMPLE_BLOCKS
+// temporal mode: one of RSM_SAMPLE_BLOCKS consecutive blocks of RSM_SAMPLE_NUM samples, picked
+// by frame and over 4x4 pixel tiles, so RSM_SAMPLE_BLOCKS frames cover all the blocks. Aligned
+// blocks of the Sobol set are stratified on their own.
+uniform int rsmFrame;
+#endif
+
+// rotation of sample sets by the blue noise of this pixel; neighbouring pixels rotate
+// differently, so what error remains is high frequency
+mat2 pixelRotation() {
+    ivec2 noiseTexel = ivec2(gl_FragCoord.xy) % textureSize(blueNoiseMap, 0);
+    float angle = 6.28318531 * texelFetch(blueNoiseMap, noiseTexel, 0).r;
+    return mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+}
+
+#ifdef RSM_VPL
+// clustered virtual point lights extracted from the rsm once per frame, see vpl_lights.h
+#define VPL_MAX_NUM 64
+layout (std140) uniform VplLights {
+    vec4 vplPositions[VPL_MAX_NUM];
+    vec4 vplNormals[VPL_MAX_NUM];
+    vec4 vplFluxes[VPL_MAX_NUM];
+    int vplCount;
+    float vplMinDistance2; // keeps a light right next to the receiver from blowing up
+};
+
+// indirect light reaching `position` (world space) with `normal`, of any length, from every
+// virtual point light; arithmetic only
+vec3 rsmGather(vec3 position, vec3 normal) {
+    normal = normalize(normal);
+    vec3 indirect = vec3(0.0);
+    for (int i = 0; i < vplCount; i++) {
+        vec3 toReceiver = position - vplPositions[i].xyz;
+        float distance2 = max(dot(toReceiver, toReceiver), vplMinDistance2);
+        indirect += vplFluxes[i].rgb * max(0.0, dot(vplNormals[i].xyz, toReceiver))
+                    * max(0.0, dot(normal, -toReceiver)) / (distance2 * distance2);
+    }
+    return clamp(indirect, 0.0, 1.0);
+}
+#else
+// indirect light reaching `position` (world space) with `normal`, of any length, from up to
+// RSM_SAMPLE_NUM texels of each light's rsm around its projection
+vec3 rsmGather(vec3 position, vec3 normal) {
+    normal = normalize(normal);
+    int first = 0;
+#ifdef RSM_SAMPLE_BLOCKS
+    ivec2 tile = ivec2(gl_FragCoord.xy) & 3;
+    first = (rsmFrame + tile.x + 4 * tile.y) % RSM_SAMPLE_BLOCKS * RSM_SAMPLE_NUM;
+#endif
+    mat2 rotation = pixelRotation();
+
+    vec3 indirect = vec3(0.0, 0.0, 0.0);
+    for (int light = 0; light < lightCount; light++) {
+        int face = rsmFace(position, light);
+        vec2 projCoords = rsmProject(position, light, face).xy;
+        int sampleNum = max(int(float(RSM_SAMPLE_NUM) * lights[light].rsmSampleShare + 0.5), 1);
+
+        vec3 lightIndirect = vec3(0.0);
+        for (int i = 0; i < RSM_SAMPLE_NUM; i++) {
+            // any prefix of the Sobol set is well spread too
+            if (i >= sampleNum) break;
+            vec3 r = texelFetch(randomMap, ivec2(first + i, 0), 0).xyz;
+            vec2 sample_coord = projCoords + rotation * r.xy * shadowRadius;
+            int sampleFace = face;
+            // off the edge of a cube face: go on in the face the sample's direction points to
+            if (lights[light].faceCount > 1
+                && (any(lessThan(sample_coord, vec2(0.0)))
+                    || any(greaterThan(sample_coord, vec2(1.0))))) {
+                vec3 beyond = rsmWorldPos(sample_coord, 0.5, light, face);
+                sampleFace = rsmFace(beyond, light);
+                sample_coord = rsmProject(beyond, light, sampleFace).xy;
+            }
+            vec3 coord = rsmCoord(sample_coord, light, sampleFace);
+            float weight = r.z;
+
+#ifdef RSM_COMPACT
+            vec3 target_normal = octDecode(texture(normalMap, coord).xy);
+            vec3 target_worldPos =
+                rsmWorldPos(sample_coord, texture(depthMap, coord).r, light, sampleFace);
+#else
+            vec3 target_normal = normalize(texture(normalMap, coord).xyz);
+            vec3 target_worldPos = texture(worldPosMap, coord).xyz;
+#endif
+            vec3 target_flux = texture(fluxMap, coord).rgb;
+
+            vec3 indirect_result = target_flux * max(0, dot(target_normal, position - target_worldPos)) * max(0, dot(normal, target_worldPos - position)) / pow(length(position - target_worldPos), 4.0);
+            indirect_result *= weight;
+            lightIndirect += indirect_result;
+        }
+        indirect += lightIndirect / float(sampleNum);
+    }
+    return clamp(indirect, 0.0, 1.0);
+}
+#endif
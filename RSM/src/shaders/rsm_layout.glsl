@@ -0,0 +1,51 @@
+// Encodings of the compact rsm layout (RSM_COMPACT): normals are octahedron-mapped into
+// RG16_SNORM and world positions are not stored at all but rebuilt from depthMap. Also where a
+// light's rsm faces live in the rsm arrays.
+
+#include "light_list.glsl"
+
+vec2 octWrap(vec2 v) {
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : octWrap(n.xy);
+}
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = octWrap(n.xy);
+    return normalize(n);
+}
+
+// face of light `light`'s rsm that sees `position`: the only one of a spotlight, for a point
+// light the cube face of the major axis of the direction from the light
+int rsmFace(vec3 position, int light) {
+    if (lights[light].faceCount == 1) return 0;
+    vec3 direction = position - lights[light].position.xyz;
+    vec3 size = abs(direction);
+    if (size.x >= size.y && size.x >= size.z) return direction.x >= 0.0 ? 0 : 1;
+    if (size.y >= size.z) return direction.y >= 0.0 ? 2 : 3;
+    return direction.z >= 0.0 ? 4 : 5;
+}
+
+// uv and depth of `position` in face `face` of light `light`'s rsm
+vec3 rsmProject(vec3 position, int light, int face) {
+    vec4 clip = lights[light].lightSpaceMatrices[face] * vec4(position, 1.0);
+    return clip.xyz / clip.w * 0.5 + 0.5;
+}
+
+// texture coordinates in the rsm arrays of `uv` in face `face` of light `light`'s rsm; a face
+// covers the lower left rsmScale of its layer
+vec3 rsmCoord(vec2 uv, int light, int face) {
+    return vec3(uv * lights[light].rsmScale, float(lights[light].firstLayer + face));
+}
+
+// world position of the texel at `uv` of face `face` of light `light`'s rsm whose depth is
+// `depth`
+vec3 rsmWorldPos(vec2 uv, float depth, int light, int face) {
+    vec4 world = lights[light].inverseLightSpaceMatrices[face]
+                 * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    return world.xyz / world.w;
+}
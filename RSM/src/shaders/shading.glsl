@@ -0,0 +1,221 @@
+// Direct light, shadow and rsm indirect light of a surface point, shared by the forward
+// (main_shader.frag) and the deferred (deferred_shader.frag) path.
+
+#include "material.glsl"
+#include "frame_constants.glsl"
+#include "light_list.glsl"
+#include "rsm_layout.glsl"
+#include "rsm_gather.glsl"
+
+uniform float shadowBias;
+
+uniform float indirectWeight;
+
+#ifdef RSM_UPSAMPLE
+// indirect light computed at 1/indirectDownsample of the resolution by indirect_shader.frag,
+// next to the geometry it was computed for
+uniform sampler2D indirectMap;
+uniform sampler2D geometryPositionMap;
+uniform sampler2D geometryNormalMap;
+uniform int indirectDownsample;
+
+// joint bilateral upsampling: the four nearest low resolution texels weighted by bilinear
+// distance and by how well their depth and unit `normal` match this fragment. False when none
+// of them matches, e.g. on silhouettes and thin geometry the low resolution image missed.
+bool upsampleIndirect(vec3 position, vec3 normal, out vec3 indirect) {
+    ivec2 lowSize = textureSize(indirectMap, 0);
+    vec2 lowCoord = gl_FragCoord.xy / float(indirectDownsample) - 0.5;
+    ivec2 base = ivec2(floor(lowCoord));
+    vec2 f = lowCoord - vec2(base);
+    float depth = length(position - viewPos.xyz);
+
+    indirect = vec3(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), lowSize - 1);
+        vec4 lowPosition = texelFetch(geometryPositionMap, texel, 0);
+        if (lowPosition.w <= 0.0) continue;
+        vec3 lowNormal = normalize(texelFetch(geometryNormalMap, texel, 0).xyz);
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y
+                       * pow(max(dot(normal, lowNormal), 0.0), 16.0)
+                       * max(0.0, 1.0 - abs(lowPosition.w - depth) / (0.05 * depth));
+        indirect += weight * texelFetch(indirectMap, texel, 0).rgb;
+        total += weight;
+    }
+    if (total < 0.05) return false;
+    indirect /= total;
+    return true;
+}
+#endif
+
+// shadow filtering, one per variant
+#define SHADOW_HARD 0     // one manual depth compare
+#define SHADOW_HARDWARE 1 // four hardware compares with bilinear PCF, a 3x3 texel tent
+#define SHADOW_POISSON 2  // 16 compares on a rotated Poisson disk, 4 if its outer ring agrees
+#define SHADOW_PCSS 3     // 16 tap blocker search, then the Poisson kernel at the penumbra size
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_HARD
+#endif
+
+// the rsm depth again, through a sampler object with depth compare and linear filtering;
+// returns the lit fraction
+uniform sampler2DArrayShadow shadowMap;
+uniform float shadowLightSize;  // PCSS light size, in rsm uv of a full layer
+uniform vec2 shadowLightPlanes; // near and far of the light projection
+
+#if SHADOW_FILTER != SHADOW_HARD
+// a tap at `uv` of the rsm arrays kept within the part of the layer light `light` renders to,
+// so neither it nor its filtering reaches texels left over from a larger rsm
+vec2 shadowTap(vec2 uv, int light) {
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    return clamp(uv, vec2(0.0), lights[light].rsmScale - 0.5 * texelSize);
+}
+#endif
+
+#if SHADOW_FILTER == SHADOW_POISSON || SHADOW_FILTER == SHADOW_PCSS
+// the first four taps are the outer ring, one per quadrant
+const vec2 poissonDisk[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725),
+    vec2(0.97484398, 0.75648379), vec2(-0.81409955, 0.91437590),
+    vec2(-0.094184101, -0.92938870), vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464),
+    vec2(-0.38277543, 0.27676845), vec2(0.44323325, -0.97511554),
+    vec2(0.53742981, -0.47373420), vec2(-0.26496911, -0.41893023),
+    vec2(0.79197514, 0.19090188), vec2(-0.24188840, 0.99706507),
+    vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790));
+
+// `coord` is in the rsm arrays, in the layer of light `light`
+float poissonPcf(vec3 coord, float depth, float radius, mat2 rotation, int light) {
+    float lit = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 uv = shadowTap(coord.xy + rotation * poissonDisk[i] * radius, light);
+        lit += texture(shadowMap, vec4(uv, coord.z, depth));
+    }
+    // fully lit or fully shadowed all around, the inner taps would agree
+    if (lit == 0.0 || lit == 4.0) return lit / 4.0;
+    for (int i = 4; i < 16; i++) {
+        vec2 uv = shadowTap(coord.xy + rotation * poissonDisk[i] * radius, light);
+        lit += texture(shadowMap, vec4(uv, coord.z, depth));
+    }
+    return lit / 16.0;
+}
+#endif
+
+#if SHADOW_FILTER == SHADOW_PCSS
+// distance along the light's view direction of a rsm depth
+float lightViewDepth(float depth) {
+    float near = shadowLightPlanes.x;
+    float far = shadowLightPlanes.y;
+    return 2.0 * near * far / (far + near - (depth * 2.0 - 1.0) * (far - near));
+}
+#endif
+
+// 1 where `position` is in shadow of light `light`, 0 where it is lit; `projCoords` is its uv
+// and depth in face `face` of the light's rsm
+float shadowCalculation(vec3 projCoords, vec3 position, vec3 normal, int light, int face) {
+    // outside a spotlight's rsm, like the zero depth border of a whole layer
+    if (any(lessThan(projCoords.xy, vec2(0.0))) || any(greaterThan(projCoords.xy, vec2(1.0))))
+        return 1.0;
+    vec3 coord = rsmCoord(projCoords.xy, light, face);
+    // get depth of current fragment from light's perspective
+    float currentDepth = projCoords.z;
+
+    // calculate bias
+    normal = normalize(normal);
+    vec3 lightDir = normalize(lights[light].position.xyz - position);
+    float bias = max(0.0005 * (1.0 - dot(normal, lightDir)), 0.00005);
+    float depth = currentDepth - bias;
+
+#if SHADOW_FILTER == SHADOW_HARDWARE
+    // each tap filters the compare results of 2x2 texels
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texelSize;
+        lit += texture(shadowMap, vec4(shadowTap(coord.xy + offset, light), coord.z, depth));
+    }
+    return 1.0 - lit / 4.0;
+#elif SHADOW_FILTER == SHADOW_POISSON
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    return 1.0 - poissonPcf(coord, depth, 2.0 * texelSize.x, pixelRotation(), light);
+#elif SHADOW_FILTER == SHADOW_PCSS
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    mat2 rotation = pixelRotation();
+    // blockers: average depth of what is closer to the light within the light's footprint
+    float receiver = lightViewDepth(depth);
+    float searchRadius = shadowLightSize * (receiver - shadowLightPlanes.x) / receiver;
+    float blockerSum = 0.0;
+    int blockers = 0;
+    for (int i = 0; i < 16; i++) {
+        vec2 uv = shadowTap(coord.xy + rotation * poissonDisk[i] * searchRadius, light);
+        float blocker = texture(depthMap, vec3(uv, coord.z)).r;
+        if (blocker < depth) {
+            blockerSum += lightViewDepth(blocker);
+            blockers++;
+        }
+    }
+    if (blockers == 0) return 0.0;
+    // similar triangles between light, blocker and receiver
+    float blocker = blockerSum / float(blockers);
+    float penumbra = (receiver - blocker) / blocker * shadowLightSize;
+    return 1.0 - poissonPcf(coord, depth, clamp(penumbra, texelSize.x, searchRadius), rotation,
+                            light);
+#else
+    // get closest depth value from light's perspective
+    float closestDepth = texture(depthMap, coord).r;
+    return depth > closestDepth ? 1.0 : 0.0;
+#endif
+}
+
+// color of `position` with `normal` and diffuse `albedo`, before gamma correction; `normal`
+// need not be unit length, the model matrix of the planes scales it
+vec3 shade(vec3 position, vec3 normal, vec3 albedo) {
+    normal = normalize(normal);
+
+    // RSM
+#ifdef RSM_UPSAMPLE
+    vec3 indirect;
+    if (!upsampleIndirect(position, normal, indirect)) indirect = rsmGather(position, normal);
+#else
+    vec3 indirect = rsmGather(position, normal);
+#endif
+
+    // ambient
+    vec3 ambient = light.ambient * material.ambient;
+
+    vec3 viewDir = normalize(viewPos.xyz - position);
+    vec3 direct = vec3(0.0);
+    for (int i = 0; i < lightCount; i++) {
+        // calculate coordinate in light space, of the cube face that sees it for a point light
+        int face = rsmFace(position, i);
+        vec3 projCoords = rsmProject(position, i, face);
+
+        // calculate shadow
+        float shadow = shadowCalculation(projCoords, position, normal, i, face);
+
+        vec3 lightDir = normalize(lights[i].position.xyz - position);
+
+        // diffuse
+        float diff = max(dot(normal, lightDir), 0.0);
+        vec3 diffuse = lights[i].diffuse.rgb * diff * albedo;
+
+        // specular
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+        vec3 specular = light.specular * spec * material.specular;
+
+        direct += (diffuse + specular) * (1.0 - shadow);
+    }
+
+    // attenuation
+    // (we don't do that in small scene)
+    // float dist = length(lights[i].position.xyz - position);
+    // float attenuation = min(1.0, 1.0 / (light.constant + light.linear * dist + light.quadratic * dist * dist));
+    // ambient *= attenuation;
+    // diffuse *= attenuation;
+    // specular *= attenuation;
+    
+    return ambient + direct + indirect * indirectWeight;
+}
@@ -0,0 +1,52 @@
+#version 330 core
+// temporal accumulation of the indirect light: this frame's partial gather is blended into the
+// history reprojected from the previous frame
+layout (location=0) out vec4 history; // accumulated indirect light, camera distance in w
+
+uniform sampler2D geometryPositionMap;
+uniform sampler2D currentIndirectMap;
+uniform sampler2D previousHistoryMap;
+uniform mat4 previousViewProjection;
+uniform vec3 previousViewPos;
+uniform bool historyValid;
+uniform float historyWeight; // share of the history in the blend
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(currentIndirectMap, 0);
+    vec4 position = texelFetch(geometryPositionMap, texel, 0);
+    // nothing was drawn here
+    if (position.w <= 0.0) {
+        history = vec4(0.0);
+        return;
+    }
+    vec3 current = texelFetch(currentIndirectMap, texel, 0).rgb;
+
+    // neighbouring pixels gathered other sample subsets this frame; their range bounds what the
+    // converged value can be, which keeps stale history from ghosting
+    vec3 low = current;
+    vec3 high = current;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 neighbour = clamp(texel + ivec2(x, y), ivec2(0), size - 1);
+            if (texelFetch(geometryPositionMap, neighbour, 0).w <= 0.0) continue;
+            vec3 c = texelFetch(currentIndirectMap, neighbour, 0).rgb;
+            low = min(low, c);
+            high = max(high, c);
+        }
+    }
+
+    // where this surface point was on the previous frame's screen
+    float weight = historyValid ? historyWeight : 0.0;
+    vec4 clip = previousViewProjection * vec4(position.xyz, 1.0);
+    vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+    if (clip.w <= 0.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+        weight = 0.0;
+    ivec2 previousTexel = clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+    vec4 previous = texelFetch(previousHistoryMap, previousTexel, 0);
+    // disocclusion: the previous frame saw another surface there
+    float distance = length(position.xyz - previousViewPos);
+    if (abs(previous.w - distance) > 0.05 * distance) weight = 0.0;
+
+    history = vec4(mix(current, clamp(previous.rgb, low, high), weight), position.w);
+}
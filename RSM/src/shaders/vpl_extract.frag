@@ -0,0 +1,68 @@
+#version 330 core
+// reduces the rsm to one virtual point light per cell of a coarse grid: the flux weighted mean
+// of 8x8 stratified texels of the cell, see vpl_lights.h. Each layer of the rsm arrays, a face
+// of some light's rsm, has a grid, stacked vertically.
+layout (location=0) out vec4 vplPosition;
+layout (location=1) out vec4 vplNormal;
+layout (location=2) out vec4 vplFlux;
+
+uniform sampler2DArray depthMap;
+uniform sampler2DArray normalMap;
+uniform sampler2DArray worldPosMap; // reference layout only
+uniform sampler2DArray fluxMap;
+// cells per side of one light's grid
+uniform int vplGrid;
+// what one cell's mean flux is worth next to the gather's weighted disk average
+uniform float vplFluxScale;
+
+#include "rsm_layout.glsl"
+
+void main() {
+    vec2 cell = floor(gl_FragCoord.xy);
+    int layer = int(cell.y) / vplGrid;
+    cell.y -= float(layer * vplGrid);
+    // the light and face the layer belongs to, none past the last one
+    int light = lightCount;
+    int face = 0;
+    for (int i = 0; i < lightCount; i++) {
+        if (layer >= lights[i].firstLayer && layer < lights[i].firstLayer + lights[i].faceCount) {
+            light = i;
+            face = layer - lights[i].firstLayer;
+        }
+    }
+    vec3 position = vec3(0.0);
+    vec3 normal = vec3(0.0);
+    vec3 flux = vec3(0.0);
+    float total = 0.0;
+    for (int y = 0; y < 8 && light < lightCount; y++) {
+        for (int x = 0; x < 8; x++) {
+            vec2 uv = (cell + (vec2(x, y) + 0.5) / 8.0) / float(vplGrid);
+            vec3 coord = rsmCoord(uv, light, face);
+            vec3 texelFlux = texture(fluxMap, coord).rgb;
+            // importance: where the flux is, by luminance
+            float weight = dot(texelFlux, vec3(0.2126, 0.7152, 0.0722));
+#ifdef RSM_COMPACT
+            vec3 texelNormal = octDecode(texture(normalMap, coord).xy);
+            vec3 texelPosition = rsmWorldPos(uv, texture(depthMap, coord).r, light, face);
+#else
+            vec3 texelNormal = normalize(texture(normalMap, coord).xyz);
+            vec3 texelPosition = texture(worldPosMap, coord).xyz;
+#endif
+            position += weight * texelPosition;
+            normal += weight * texelNormal;
+            flux += texelFlux;
+            total += weight;
+        }
+    }
+    // a dark cell, or one of a layer no light uses, gives a light without flux, which the
+    // clustering drops
+    if (total <= 0.0) {
+        vplPosition = vec4(0.0);
+        vplNormal = vec4(0.0, 0.0, 1.0, 0.0);
+        vplFlux = vec4(0.0);
+        return;
+    }
+    vplPosition = vec4(position / total, 1.0);
+    vplNormal = vec4(normalize(normal), 0.0);
+    vplFlux = vec4(flux / 64.0 * vplFluxScale, 0.0);
+}
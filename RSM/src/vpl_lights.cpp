@@ -0,0 +1,169 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#include "vpl_lights.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// k-means rounds per frame, warm started from the last frame
+constexpr auto KMEANS_ITERATIONS{4};
+// world units a quarter turn of the normal counts as, in the clustering distance
+constexpr auto NORMAL_WEIGHT{10.0f};
+
+float luminance(const glm::vec3& flux) {
+    return glm::dot(flux, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+}  // namespace
+
+VplLights::VplLights(float minDistance, int sources) : cellCount{GRID * GRID * sources} {
+    block.minDistance2 = minDistance * minDistance;
+    auto mapBytes{cellCount * sizeof(glm::vec4)};
+
+    glGenTextures(3, maps.data());
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    for (std::size_t i{0}; i < maps.size(); i++) {
+        glBindTexture(GL_TEXTURE_2D, maps[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, GRID, GRID * sources, 0, GL_RGBA, GL_FLOAT,
+                     nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, maps[i],
+                               0);
+    }
+    GLenum drawBuffers[]{GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, drawBuffers);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(2, pbo.data());
+    for (auto buffer : pbo) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, maps.size() * mapBytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+}
+
+VplLights::~VplLights() {
+    for (auto sync : fence)
+        if (sync) glDeleteSync(sync);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(3, maps.data());
+    glDeleteBuffers(2, pbo.data());
+    glDeleteBuffers(1, &ubo);
+}
+
+void VplLights::capture() {
+    // a capture that never got consumed is simply replaced
+    if (fence[slot]) glDeleteSync(fence[slot]);
+    auto height{cellCount / GRID};
+    auto mapBytes{cellCount * sizeof(glm::vec4)};
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+    for (std::size_t i{0}; i < maps.size(); i++) {
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glReadPixels(0, 0, GRID, height, GL_RGBA, GL_FLOAT,
+                     reinterpret_cast<void*>(static_cast<std::uintptr_t>(i * mapBytes)));
+    }
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot ^= 1;
+}
+
+void VplLights::update() {
+    auto& sync{fence[slot]};
+    if (!sync) return;
+    auto status{glClientWaitSync(sync, 0, 0)};
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+    glDeleteSync(sync);
+    sync = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo[slot]);
+    if (auto data{static_cast<const glm::vec4*>(glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, maps.size() * cellCount * sizeof(glm::vec4),
+            GL_MAP_READ_BIT))}) {
+        cluster(data, data + cellCount, data + 2 * cellCount);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+    uploaded = true;
+}
+
+void VplLights::cluster(const glm::vec4* positions, const glm::vec4* normals,
+                        const glm::vec4* fluxes) {
+    struct Light {
+        glm::vec3 position, normal, flux;
+        float weight;
+    };
+    std::vector<Light> lights;
+    for (int i{0}; i < cellCount; i++) {
+        glm::vec3 flux{fluxes[i]};
+        if (auto weight{luminance(flux)}; weight > 0.0f)
+            lights.push_back({glm::vec3(positions[i]), glm::vec3(normals[i]), flux, weight});
+    }
+    auto k{std::min<std::size_t>(MAX_NUM, lights.size())};
+
+    // seeds: the last clusters while there are as many, the brightest lights otherwise
+    if (centroids.size() != k) {
+        std::sort(lights.begin(), lights.end(),
+                  [](const Light& a, const Light& b) { return a.weight > b.weight; });
+        centroids.clear();
+        for (std::size_t i{0}; i < k; i++)
+            centroids.push_back({lights[i].position, lights[i].normal});
+    }
+
+    auto distance{[](const Light& light, const Centroid& centroid) {
+        auto offset{light.position - centroid.position};
+        return glm::dot(offset, offset) +
+               NORMAL_WEIGHT * NORMAL_WEIGHT * (1.0f - glm::dot(light.normal, centroid.normal));
+    }};
+    std::vector<std::size_t> assignment(lights.size());
+    std::vector<Light> sums(k);
+    for (auto iteration{0}; iteration < KMEANS_ITERATIONS; iteration++) {
+        std::fill(sums.begin(), sums.end(), Light{});
+        for (std::size_t i{0}; i < lights.size(); i++) {
+            std::size_t nearest{0};
+            for (std::size_t c{1}; c < k; c++) {
+                if (distance(lights[i], centroids[c]) < distance(lights[i], centroids[nearest]))
+                    nearest = c;
+            }
+            assignment[i] = nearest;
+            auto& sum{sums[nearest]};
+            sum.position += lights[i].weight * lights[i].position;
+            sum.normal += lights[i].weight * lights[i].normal;
+            sum.flux += lights[i].flux;
+            sum.weight += lights[i].weight;
+        }
+        // empty clusters keep their place and may pick up lights next time
+        for (std::size_t c{0}; c < k; c++) {
+            if (sums[c].weight <= 0.0f) continue;
+            centroids[c].position = sums[c].position / sums[c].weight;
+            if (auto length{glm::length(sums[c].normal)}; length > 0.0f)
+                centroids[c].normal = sums[c].normal / length;
+        }
+    }
+
+    block.count = 0;
+    for (std::size_t c{0}; c < k; c++) {
+        if (sums[c].weight <= 0.0f) continue;
+        block.positions[block.count] = glm::vec4(centroids[c].position, 1.0f);
+        block.normals[block.count] = glm::vec4(centroids[c].normal, 0.0f);
+        block.fluxes[block.count] = glm::vec4(sums[c].flux, 0.0f);
+        block.count++;
+    }
+}
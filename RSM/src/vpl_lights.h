@@ -0,0 +1,90 @@
+// Copyright (c) 2021 Guyutongxue
+// 
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef VPL_LIGHTS_H
+#define VPL_LIGHTS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+// Virtual point lights of the rsm, the alternative gather (RSM_VPL). vpl_extract.frag reduces
+// the rsm of each light to one virtual light per cell of a GRID x GRID grid, the grids stacked
+// in one target; that is read back asynchronously (a frame or two late, the gpu is never waited
+// on), clustered on the cpu over all lights by flux weighted k-means
+// into at most MAX_NUM lights and uploaded to the std140 block
+//
+//     layout (std140) uniform VplLights {
+//         vec4 vplPositions[64];
+//         vec4 vplNormals[64];
+//         vec4 vplFluxes[64];
+//         int vplCount;
+//         float vplMinDistance2;
+//     };
+//
+// which the fragment shaders iterate without touching a texture.
+class VplLights {
+public:
+    static constexpr GLuint binding{2};
+    static constexpr const char* const blockName{"VplLights"};
+    static constexpr int GRID{16};
+    static constexpr int MAX_NUM{64};
+
+    // target of vpl_extract.frag: position, normal and flux per cell, GRID x GRID * `sources`
+    GLuint fbo;
+
+    // lights closer to a receiver than `minDistance` are evaluated as if at that distance;
+    // `sources` is the most rsms extracted at once
+    VplLights(float minDistance, int sources);
+    VplLights(const VplLights&) = delete;
+    ~VplLights();
+
+    // queues the read back of what vpl_extract.frag just drew
+    void capture();
+    // clusters and uploads the oldest capture if it has arrived
+    void update();
+    // lights have been uploaded at least once
+    bool ready() const {
+        return uploaded;
+    }
+    int count() const {
+        return block.count;
+    }
+
+private:
+    struct Block {
+        std::array<glm::vec4, MAX_NUM> positions;
+        std::array<glm::vec4, MAX_NUM> normals;
+        std::array<glm::vec4, MAX_NUM> fluxes;
+        GLint count;
+        float minDistance2;
+        float padding[2];
+    };
+    static_assert(sizeof(Block) == (3 * 4 * MAX_NUM + 4) * sizeof(float));
+
+    struct Centroid {
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+
+    int cellCount;
+    std::array<GLuint, 3> maps;
+    GLuint ubo;
+    // two read backs in flight; `slot` is written next and holds the older one
+    std::array<GLuint, 2> pbo;
+    std::array<GLsync, 2> fence{};
+    int slot{0};
+    Block block{};
+    bool uploaded{false};
+    // last frame's clusters seed this frame's
+    std::vector<Centroid> centroids;
+
+    void cluster(const glm::vec4* positions, const glm::vec4* normals, const glm::vec4* fluxes);
+};
+
+#endif
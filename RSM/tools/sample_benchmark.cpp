@@ -0,0 +1,128 @@
+// Copyright (c) 2021 Guyutongxue
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+// Error of the rsm gather per sample count, against a high-sample reference:
+//
+//     sample_benchmark [quality bar, default 0.05]
+//
+// Runs the gather's estimator (offsets in the unit disk weighted by r^2, see rsm_gather.glsl)
+// over synthetic flux fields, one per pixel of a 64 x 64 tile: a hard edge at a random angle,
+// like a wall corner in the rsm, plus a smooth blob. The reference takes 2^16 samples. Prints
+// the relative RMS error of the old shared white-noise set and of the Sobol set rotated by the
+// blue noise, and the lowest count of the Sobol set whose error meets the bar.
+
+#include "sample_sets.h"
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numbers>
+#include <random>
+#include <vector>
+
+namespace {
+
+// the settings of main.cpp
+constexpr std::array SAMPLE_NUM_CHOICES{16u, 32u, 64u, 128u, 256u};
+constexpr auto MAX_SAMPLE_NUM{256u};
+constexpr auto REFERENCE_SAMPLE_NUM{1u << 16};
+
+struct Field {
+    float edgeX, edgeY, edgeOffset;
+    float low, high;
+    float blobX, blobY, blobSize, blobFlux;
+
+    float operator()(float x, float y) const {
+        auto flux{x * edgeX + y * edgeY > edgeOffset ? high : low};
+        auto dx{x - blobX}, dy{y - blobY};
+        return flux + blobFlux * std::exp(-(dx * dx + dy * dy) / (blobSize * blobSize));
+    }
+};
+
+using Offsets = std::vector<std::array<float, 3>>;
+
+// mean of the first `count` weighted samples of `field`, offsets rotated by `angle`
+float gather(const Field& field, const Offsets& offsets, std::size_t count, float angle) {
+    auto c{std::cos(angle)}, s{std::sin(angle)};
+    auto sum{0.0f};
+    for (std::size_t i{0}; i < count; i++) {
+        auto [x, y, weight] = offsets[i];
+        sum += weight * field(c * x - s * y, s * x + c * y);
+    }
+    return sum / count;
+}
+
+// what createRandomTexture did before: uniform radius and angle from a random engine, one set
+// shared by every pixel
+Offsets whiteNoiseOffsets(std::size_t count, std::uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    Offsets offsets(count);
+    for (auto& [x, y, weight] : offsets) {
+        auto r{dist(random)}, angle{dist(random)};
+        x = r * std::sin(2 * std::numbers::pi_v<float> * angle);
+        y = r * std::cos(2 * std::numbers::pi_v<float> * angle);
+        weight = r * r;
+    }
+    return offsets;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    auto bar{argc > 1 ? std::strtof(argv[1], nullptr) : 0.05f};
+
+    std::mt19937 random(SAMPLE_SEED);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    std::vector<Field> fields(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+    for (auto& field : fields) {
+        auto edgeAngle{2 * std::numbers::pi_v<float> * dist(random)};
+        field.edgeX = std::cos(edgeAngle);
+        field.edgeY = std::sin(edgeAngle);
+        field.edgeOffset = dist(random) - 0.5f;
+        field.low = dist(random) * 0.2f;
+        field.high = dist(random);
+        field.blobX = dist(random) * 2.0f - 1.0f;
+        field.blobY = dist(random) * 2.0f - 1.0f;
+        field.blobSize = 0.1f + dist(random) * 0.4f;
+        field.blobFlux = dist(random);
+    }
+
+    auto reference{rsmSampleOffsets(REFERENCE_SAMPLE_NUM, SAMPLE_SEED + 1)};
+    auto sobol{rsmSampleOffsets(MAX_SAMPLE_NUM, SAMPLE_SEED)};
+    auto white{whiteNoiseOffsets(MAX_SAMPLE_NUM, SAMPLE_SEED)};
+    auto noise{blueNoise(BLUE_NOISE_SIZE, SAMPLE_SEED)};
+
+    std::vector<float> expected(fields.size());
+    auto mean{0.0f};
+    for (std::size_t p{0}; p < fields.size(); p++) {
+        expected[p] = gather(fields[p], reference, reference.size(), 0.0f);
+        mean += expected[p] / fields.size();
+    }
+
+    std::printf("%8s %14s %14s\n", "samples", "white noise", "sobol + blue");
+    auto lowest{0u};
+    for (auto count : SAMPLE_NUM_CHOICES) {
+        auto whiteError{0.0f}, sobolError{0.0f};
+        for (std::size_t p{0}; p < fields.size(); p++) {
+            auto angle{2 * std::numbers::pi_v<float> * noise[p]};
+            auto w{gather(fields[p], white, count, 0.0f) - expected[p]};
+            auto s{gather(fields[p], sobol, count, angle) - expected[p]};
+            whiteError += w * w / fields.size();
+            sobolError += s * s / fields.size();
+        }
+        whiteError = std::sqrt(whiteError) / mean;
+        sobolError = std::sqrt(sobolError) / mean;
+        std::printf("%8u %14.4f %14.4f\n", count, whiteError, sobolError);
+        if (!lowest && sobolError <= bar) lowest = count;
+    }
+
+    if (lowest)
+        std::printf("lowest sample count within %.3f: %u\n", bar, lowest);
+    else
+        std::printf("no sample count within %.3f\n", bar);
+    return EXIT_SUCCESS;
+}